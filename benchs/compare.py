@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""Compares two result files of run_benchs.py (base and new build).
+
+For each (instance, mode, strategy) it reports the mean of --metric in both
+builds and flags:
+  - SLOWER : new mean > base mean * (1 + --min-change) and a one-sided Welch
+             t-test gives p < --alpha (with a single run per side only the
+             ratio is checked)
+  - WRONG  : the optimum differs between the builds
+Exit status is 1 if something is flagged. Example:
+
+    ./compare.py results/base.csv results/new.csv --metric wall
+"""
+
+import argparse
+import csv
+import math
+import sys
+from collections import defaultdict
+
+
+def betacf(a, b, x):
+    # continued fraction of the incomplete beta function (Numerical Recipes)
+    fpmin = 1e-300
+    qab, qap, qam = a + b, a + 1.0, a - 1.0
+    c, d = 1.0, 1.0 - qab * x / qap
+    d = 1.0 / (d if abs(d) > fpmin else fpmin)
+    h = d
+    for m in range(1, 200):
+        m2 = 2 * m
+        aa = m * (b - m) * x / ((qam + m2) * (a + m2))
+        d = 1.0 + aa * d
+        d = 1.0 / (d if abs(d) > fpmin else fpmin)
+        c = 1.0 + aa / c
+        c = c if abs(c) > fpmin else fpmin
+        h *= d * c
+        aa = -(a + m) * (qab + m) * x / ((a + m2) * (qap + m2))
+        d = 1.0 + aa * d
+        d = 1.0 / (d if abs(d) > fpmin else fpmin)
+        c = 1.0 + aa / c
+        c = c if abs(c) > fpmin else fpmin
+        de = d * c
+        h *= de
+        if abs(de - 1.0) < 1e-12:
+            break
+    return h
+
+
+def betai(a, b, x):
+    if x <= 0.0:
+        return 0.0
+    if x >= 1.0:
+        return 1.0
+    bt = math.exp(math.lgamma(a + b) - math.lgamma(a) - math.lgamma(b)
+                  + a * math.log(x) + b * math.log(1.0 - x))
+    if x < (a + 1.0) / (a + b + 2.0):
+        return bt * betacf(a, b, x) / a
+    return 1.0 - bt * betacf(b, a, 1.0 - x) / b
+
+
+def welch_greater(base, new):
+    """p-value of H1: mean(new) > mean(base)"""
+    n1, n2 = len(base), len(new)
+    m1, m2 = sum(base) / n1, sum(new) / n2
+    v1 = sum((x - m1) ** 2 for x in base) / (n1 - 1)
+    v2 = sum((x - m2) ** 2 for x in new) / (n2 - 1)
+    se2 = v1 / n1 + v2 / n2
+    if se2 == 0:
+        return 0.0 if m2 > m1 else 1.0
+    t = (m2 - m1) / math.sqrt(se2)
+    df = se2 ** 2 / ((v1 / n1) ** 2 / (n1 - 1) + (v2 / n2) ** 2 / (n2 - 1))
+    tail = 0.5 * betai(df / 2.0, 0.5, df / (df + t * t))  # P(T > |t|)
+    return tail if t > 0 else 1.0 - tail
+
+
+def load(path, metric):
+    values = defaultdict(list)
+    optimum = {}
+    with open(path, newline='') as f:
+        for row in csv.DictReader(f):
+            key = (row['instance'], row['mode'], row['strategy'])
+            if row['status'] == 'optimal':
+                optimum[key] = row['optimum']
+            if row[metric] != '':
+                values[key].append(float(row[metric]))
+    return values, optimum
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__,
+                                 formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('base')
+    ap.add_argument('new')
+    ap.add_argument('--metric', default='wall',
+                    help='wall, t_solver, t_mhv, iterations, sat_calls, peak_rss_kb')
+    ap.add_argument('--alpha', type=float, default=0.05)
+    ap.add_argument('--min-change', type=float, default=0.05,
+                    help='relative slowdown ignored below this value')
+    args = ap.parse_args()
+
+    base, base_opt = load(args.base, args.metric)
+    new, new_opt = load(args.new, args.metric)
+    flagged = 0
+    print('%-22s %-8s %3s %12s %12s %7s %8s  %s' %
+          ('instance', 'mode', '-t', 'base', 'new', 'ratio', 'p', 'flag'))
+    for key in sorted(set(base) & set(new)):
+        b, n = base[key], new[key]
+        mb, mn = sum(b) / len(b), sum(n) / len(n)
+        ratio = mn / mb if mb > 0 else (1.0 if mn == 0 else float('inf'))
+        p = welch_greater(b, n) if len(b) > 1 and len(n) > 1 else float('nan')
+        flags = []
+        if ratio > 1 + args.min_change and (math.isnan(p) or p < args.alpha):
+            flags.append('SLOWER')
+        if key in base_opt and key in new_opt and base_opt[key] != new_opt[key]:
+            flags.append('WRONG')
+        flagged += len(flags) > 0
+        print('%-22s %-8s %3s %12.3f %12.3f %7.3f %8.4f  %s' %
+              (key[0], key[1], key[2], mb, mn, ratio, p, ' '.join(flags)))
+    print('%d flagged' % flagged)
+    sys.exit(1 if flagged else 0)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""Runs mhs_wcsp over the instances in benchs/ and records one csv row per run.
+
+Each instance is solved in every mode (see MODES and --sizes) and with every
+hitting-set strategy given with --strategies, --repeat times. Example:
+
+    ./run_benchs.py --solver ../src/mhs_wcsp --modes orig td td-ac all \\
+                    --sizes 2 4 --strategies 3 4 --repeat 3 --out results/base.csv
+
+Compare two result files with compare.py.
+"""
+
+import argparse
+import csv
+import glob
+import os
+import re
+import subprocess
+import sys
+import time
+
+MODES = {
+    'orig':  lambda inst: [],
+    'td':    lambda inst: ['-p', inst + '.td.l2r'],
+    'td-ac': lambda inst: ['-p', inst + '.td.l2r', '-ac'],
+    'all':   lambda inst: ['-p', 'all'],
+}
+
+FIELDS = ['build', 'instance', 'mode', 'strategy', 'run', 'status', 'optimum',
+          'wall', 't_solver', 't_mhv', 'iterations', 'sat_calls', 'peak_rss_kb']
+
+RE_ITER = re.compile(r'Iteration (\d+) .* time (\S+) (\S+)\s+satcalls (\d+)')
+RE_OPT = re.compile(r'^(Optimum|Lower bound): (-?\d+) in')
+RE_MEM = re.compile(r'^Peak memory: (\d+) KB')
+
+
+def mode_args(mode, inst):
+    m = re.match(r'^td-s(\d+)$', mode)
+    if m:
+        return ['-p', inst + '.td.l2r', '-s', m.group(1)]
+    return MODES[mode](inst)
+
+
+def parse_output(out):
+    row = {'status': 'error', 'optimum': '', 't_solver': 0.0, 't_mhv': 0.0,
+           'iterations': 0, 'sat_calls': 0, 'peak_rss_kb': ''}
+    for line in out.splitlines():
+        m = RE_ITER.search(line)
+        if m:
+            row['iterations'] = int(m.group(1))
+            row['t_solver'] = float(m.group(2))
+            row['t_mhv'] = float(m.group(3))
+            row['sat_calls'] = int(m.group(4))
+        m = RE_OPT.match(line)
+        if m:
+            row['status'] = 'optimal' if m.group(1) == 'Optimum' else 'timeout'
+            row['optimum'] = m.group(2)
+        m = RE_MEM.match(line)
+        if m:
+            row['peak_rss_kb'] = m.group(1)
+    return row
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    ap = argparse.ArgumentParser(description=__doc__,
+                                 formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('--solver', default=os.path.join(here, '..', 'src', 'mhs_wcsp'))
+    ap.add_argument('--instances', nargs='*',
+                    default=sorted(glob.glob(os.path.join(here, '*.wcsp'))))
+    ap.add_argument('--modes', nargs='*', default=['orig', 'td', 'td-ac', 'all'],
+                    help='orig, td, td-ac, all')
+    ap.add_argument('--sizes', nargs='*', type=int, default=[],
+                    help='adds a mode td-sN (-p instance.td.l2r -s N) for each size')
+    ap.add_argument('--strategies', nargs='*', type=int, default=[3],
+                    help='values of -t')
+    ap.add_argument('--repeat', type=int, default=1)
+    ap.add_argument('--time', type=float, default=0,
+                    help='wall-clock limit passed to the solver (-time), 0: none')
+    ap.add_argument('--extra', default='', help='extra solver options')
+    ap.add_argument('--build', default='', help='label of the build (default: git hash)')
+    ap.add_argument('--out', default=os.path.join(here, 'results', 'results.csv'))
+    args = ap.parse_args()
+
+    build = args.build
+    if not build:
+        try:
+            build = subprocess.check_output(['git', 'rev-parse', '--short', 'HEAD'],
+                                            cwd=here, text=True).strip()
+        except (OSError, subprocess.CalledProcessError):
+            build = 'unknown'
+
+    modes = list(args.modes) + ['td-s%d' % s for s in args.sizes]
+    os.makedirs(os.path.dirname(os.path.abspath(args.out)), exist_ok=True)
+    with open(args.out, 'w', newline='') as f:
+        writer = csv.DictWriter(f, fieldnames=FIELDS)
+        writer.writeheader()
+        for inst in args.instances:
+            for mode in modes:
+                if mode.startswith('td') and not os.path.exists(inst + '.td.l2r'):
+                    continue
+                for strategy in args.strategies:
+                    for run in range(args.repeat):
+                        cmd = [args.solver, '-f', inst, '-t', str(strategy)]
+                        cmd += mode_args(mode, inst) + args.extra.split()
+                        if args.time > 0:
+                            cmd += ['-time', str(args.time)]
+                        start = time.monotonic()
+                        proc = subprocess.run(cmd, stdout=subprocess.PIPE,
+                                              stderr=subprocess.STDOUT, text=True)
+                        wall = time.monotonic() - start
+                        row = parse_output(proc.stdout)
+                        row.update({'build': build, 'instance': os.path.basename(inst),
+                                    'mode': mode, 'strategy': strategy, 'run': run,
+                                    'wall': '%.3f' % wall})
+                        writer.writerow(row)
+                        f.flush()
+                        print('%s %s -t %d run %d: %s %s %.2fs' %
+                              (row['instance'], mode, strategy, run, row['status'],
+                               row['optimum'], wall), file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
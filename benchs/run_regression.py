@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+"""Solves the regression cases of benchs/regression/cases.txt and checks their optima.
+
+Each line is 'case | options | expected optima'; the lines of a case run in
+order and share a temporary directory ({tmp} in the options). Example:
+
+    ./run_regression.py --solver ../src/mhs_wcsp
+
+The exit status is 1 if some optimum differs.
+"""
+
+import argparse
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+
+RE_OPT = re.compile(r'^Optimum(?: after update \d+)?: (-?\d+) in')
+
+
+def read_cases(path):
+    cases = []
+    for line in open(path):
+        line = line.strip()
+        if not line or line.startswith('#'):
+            continue
+        name, options, expected = [s.strip() for s in line.split('|')]
+        cases.append((name, options.split(), expected.split()))
+    return cases
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    ap = argparse.ArgumentParser(description=__doc__,
+                                 formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('--solver', default=os.path.join(here, '..', 'src', 'mhs_wcsp'))
+    ap.add_argument('--cases', default=os.path.join(here, 'regression', 'cases.txt'))
+    ap.add_argument('--time', type=float, default=600,
+                    help='timeout of each run in seconds')
+    args = ap.parse_args()
+
+    solver = os.path.abspath(args.solver)
+    cwd = os.path.dirname(os.path.abspath(args.cases))
+    tmp = {}
+    failed = 0
+    try:
+        for name, options, expected in read_cases(args.cases):
+            if name not in tmp:
+                tmp[name] = tempfile.mkdtemp(prefix='mhs_' + name + '_')
+            cmd = [solver] + [o.replace('{tmp}', tmp[name]) for o in options]
+            try:
+                proc = subprocess.run(cmd, cwd=cwd, stdout=subprocess.PIPE,
+                                      stderr=subprocess.STDOUT, text=True,
+                                      timeout=args.time)
+                out = proc.stdout
+                status = proc.returncode
+            except subprocess.TimeoutExpired:
+                out, status = '', 'timeout'
+            got = [m.group(1) for m in map(RE_OPT.match, out.splitlines()) if m]
+            ok = got == expected and status == 0
+            failed += not ok
+            print('%-14s %s  optima %s%s' % (name, 'ok  ' if ok else 'FAIL', ' '.join(got) or '-',
+                  '' if ok else '  (expected %s, exit %s)' % (' '.join(expected), status)))
+    finally:
+        for d in tmp.values():
+            shutil.rmtree(d, ignore_errors=True)
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == '__main__':
+    main()
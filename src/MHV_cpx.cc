@@ -3,6 +3,7 @@
 #include <chrono>
 #include "wcsp.hh"
 #include "MHV_cpx.hh"
+#include "budget.hh"
 
 using namespace std::chrono;
 using std::vector;
@@ -65,11 +66,55 @@ void MHV_cplex::addCore(const vector<int>& core) {
     expr.end(); // clear memory [expr is passed by value to .add]
 }
 
+// consistency on h propagates the bound to h[i][m + 1], h[i][m + 2], ...
+void MHV_cplex::fixLevel(int i, int m) {
+    assert(0 < m and m < costs[i].size());
+    h[i][m].setUB(0);
+}
+
+// Solves the LP relaxation of the model and fixes to 0 every h[i][m] at 0
+// whose reduced cost shows that setting it to 1 costs more than ub.
+// Post: fixed contains the new fixings (i, m); returns how many
+int MHV_cplex::reducedCostFixing(Cost ub, vector<pair<int,int>>& fixed) {
+    const double EPS = 1e-6;
+    IloModel lp(env);
+    lp.add(model);
+    for (int i = 0; i < e; ++i) lp.add(IloConversion(env, h[i], ILOFLOAT));
+    IloCplex lp_cplex(lp);
+    lp_cplex.setOut(env.getNullStream());
+    lp_cplex.setWarning(env.getNullStream());
+    lp_cplex.setError(env.getNullStream());
+    if (Budget::timeLimit > 0) lp_cplex.setParam(IloCplex::Param::TimeLimit, Budget::remaining());
+
+    int n = 0;
+    if (lp_cplex.solve() and lp_cplex.getStatus() == IloAlgorithm::Optimal) {
+        IloNum z = lp_cplex.getObjValue();
+        for (int i = 0; i < e; ++i) {
+            IloNumArray rc(env);
+            lp_cplex.getReducedCosts(rc, h[i]);
+            for (int m = 1; m < costs[i].size(); ++m) {
+                if (h[i][m].getUB() < 0.5) break;   // already fixed
+                if (lp_cplex.getValue(h[i][m]) < EPS and z + rc[m] > ub + EPS) {
+                    h[i][m].setUB(0);
+                    fixed.push_back(make_pair(i, m));
+                    ++n;
+                    break; // consistency on h fixes the next levels
+                }
+            }
+            rc.end();
+        }
+    }
+    lp_cplex.end();
+    lp.end();
+    return n;
+}
+
 bool MHV_cplex::solve(vector<Cost>& found_h, vector<int>& found_h_idom, Cost & found_cost) {
+    if (Budget::timeLimit > 0) cplex.setParam(IloCplex::Param::TimeLimit, Budget::remaining());
     bool feasible = cplex.solve() == IloTrue;
     if (not feasible) return false;
 
-    assert(cplex.getStatus() == IloAlgorithm::Optimal);
+    if (cplex.getStatus() != IloAlgorithm::Optimal) return false; // time limit
 
     found_h = vector<Cost>(e, 0);
     found_h_idom = vector<int>(e, 0);
@@ -83,12 +128,13 @@ bool MHV_cplex::solve(vector<Cost>& found_h, vector<int>& found_h_idom, Cost & f
     return true; //feasible
 }
 
+// return false only if the budget is exhausted (the model is always feasible)
 bool MHV_cplex::solve_MHV(long& time) {
     auto start = high_resolution_clock::now();
     bool feasible = solve(best_h, best_h_idom, best_cost);
-    assert(feasible);
+    assert(feasible or Budget::expired());
     auto stop = high_resolution_clock::now();
     auto duration = duration_cast<microseconds>(stop - start);
     time += duration.count();
-    return true; //feasible
+    return feasible;
 }
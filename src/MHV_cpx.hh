@@ -15,6 +15,8 @@ public:
     ~MHV_cplex() {env.end(); }
 
     void addCore(const vector<int>& core);
+    void fixLevel(int i, int m); // h_mhv[i] < costs[i][m]
+    int reducedCostFixing(Cost ub, vector<pair<int,int>>& fixed);
     bool solve_MHV(long& time);
     Cost getCost_MHV() { return best_cost; }
     vector<int> getMHV_idom() { return best_h_idom; }
@@ -0,0 +1,30 @@
+#include <csignal>
+#include "budget.hh"
+
+double Budget::timeLimit = -1;
+int Budget::conflictLimit = -1;
+int Budget::decisionLimit = -1;
+volatile sig_atomic_t Budget::interrupted = 0;
+steady_clock::time_point Budget::deadline;
+
+void Budget::handler(int sig) {
+    interrupted = 1;
+}
+
+void Budget::start() {
+    if (timeLimit > 0)
+        deadline = steady_clock::now() + duration_cast<steady_clock::duration>(duration<double>(timeLimit));
+    signal(SIGINT, handler);
+    signal(SIGTERM, handler);
+}
+
+bool Budget::expired() {
+    if (interrupted) return true;
+    return timeLimit > 0 and steady_clock::now() >= deadline;
+}
+
+double Budget::remaining() {
+    if (timeLimit <= 0) return -1;
+    double left = duration_cast<duration<double>>(deadline - steady_clock::now()).count();
+    return left > 0 ? left : 0;
+}
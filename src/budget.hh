@@ -0,0 +1,31 @@
+#ifndef BUDGET_HH
+#define BUDGET_HH
+
+#include <chrono>
+#include <csignal>
+
+using namespace std::chrono;
+
+///resource limits of a run: wall-clock deadline, per-call sat limits and signals
+class Budget {
+protected:
+    virtual ~Budget() = 0; // Trick to avoid any instantiation
+public:
+    static double timeLimit;        // seconds from start(), <= 0 ==> no limit
+    static int conflictLimit;       // per core-minimization sat call, <= 0 ==> no limit
+    static int decisionLimit;       // per core-minimization sat call, <= 0 ==> no limit
+    static volatile sig_atomic_t interrupted; // SIGINT or SIGTERM received
+
+    // starts the clock and installs the SIGINT/SIGTERM handlers
+    static void start();
+    // true if the deadline is reached or a signal was received
+    static bool expired();
+    // seconds left until the deadline (-1 if there is no deadline)
+    static double remaining();
+
+private:
+    static steady_clock::time_point deadline;
+    static void handler(int sig);
+};
+
+#endif
@@ -0,0 +1,16 @@
+#include "config.hh"
+
+HsOption HsConfig::hsOption = HS_GREEDY;
+bool HsConfig::localSearch = false;
+bool HsConfig::hardening = false;
+bool HsConfig::rcFixing = false;
+bool HsConfig::compactHard = false;
+int HsConfig::mergeThreshold = 0;
+bool HsConfig::incremental = false;
+int HsConfig::trimConflicts = 0;
+bool HsConfig::solutionPhases = false;
+int HsConfig::encodeThreads = 1;
+std::string HsConfig::satBackend = "cadical";
+std::string HsConfig::cacheDir = "";
+std::string HsConfig::checkpointFile = "";
+double HsConfig::checkpointInterval = 60;
@@ -1,6 +1,7 @@
 #ifndef CONFIG_HH
 #define CONFIG_HH
 
+#include <string>
 
 typedef enum {
     HS_MIN = 1,
@@ -16,6 +17,19 @@ protected:
     virtual ~HsConfig() = 0; // Trick to avoid any instantiation 
 public:
     static HsOption hsOption;
+    static bool localSearch;      // background local search for upper bounds
+    static bool hardening;        // ub-based hardening of cost levels
+    static bool rcFixing;         // reduced-cost fixing from the MHV LP relaxation
+    static bool compactHard;      // linear-size amo and sorting-network sum for the hard constraints
+    static int mergeThreshold;    // cores shared by two partitions before merging them (0: never)
+    static bool incremental;      // activation literals for updates of the costs (WcspSolver::resolve)
+    static int trimConflicts;     // conflicts of each core-trimming sat call (0: no trimming)
+    static bool solutionPhases;   // sat phases from the last solution and the incumbent
+    static int encodeThreads;     // threads generating the clauses of the encoding
+    static std::string satBackend;  // incremental sat solver (see SatBackend::create)
+    static std::string cacheDir;  // directory of the cached encodings ("": no cache)
+    static std::string checkpointFile;  // cores, bounds and incumbent of the run ("": none)
+    static double checkpointInterval;   // seconds between checkpoints
 };
 
 #endif
@@ -1,6 +1,7 @@
 #ifndef CORE_CSP_HH
 #define CORE_CSP_HH
 
+#include <cstdint>
 #include <vector>
 #include <chrono>
 #include "wcsp.hh"
@@ -13,16 +14,41 @@ public:
     vector<vector<int>> C;      //cores, C ⊆ {k | h ≤ k, wcsp^k unsat}
     vector<int> sol;            //solution, wcsp^h(sol) = true
     vector<vector<Cost>> part;  // costes de las particiones
+    vector<vector<int>> members;  // functions of each partition (empty after abstract cores)
+    vector<bool> part_capped;   // sums of the partition >= ub are forbidden
     int sat_calls;
+    bool interrupted;           // solve() stopped because the budget is exhausted
+    uint64_t hash = 0;          // instance and partitions of the model (only with a cache or checkpoint)
 
-    CoreCSP(const Wcsp& wcsp) : wcsp(wcsp), sat_calls(0) {}
+    CoreCSP(const Wcsp& wcsp) : wcsp(wcsp), sat_calls(0), interrupted(false) {}
+    virtual ~CoreCSP() {}
 
     virtual void case_study_abstract_core() = 0;
+    // symbolic merging: one partition per cluster and cost of its functions
+    virtual void abstract_core(const vector<vector<int>>& clusters) = 0;
 
     // if wcsp^h sat   -> return true
     // if wcsp^h unsat -> return false & store a set of cores at C (see getCores())
     virtual bool solve(vector<int> h) = 0;
 
+    // forbids the cost levels >= c of partition f (permanently)
+    virtual void harden(int f, int c) = 0;
+
+    // merges partitions i < j into one whose levels are the sums of their costs:
+    // the merged partition replaces i and j is removed. Returns false (nothing
+    // changes) if the merged partition would have more than max_levels levels
+    virtual bool merge(int i, int j, int max_levels) = 0;
+
+    // re-encodes the functions in funcs after their costs changed (incremental
+    // mode): returns the partitions whose levels changed
+    virtual vector<int> update(const vector<int>& funcs) = 0;
+
+    // the next sat calls try the values of assignment first (HsConfig::solutionPhases)
+    virtual void set_phases(const vector<int>& assignment) = 0;
+
+    // last cost level of partition f not forbidden by harden()
+    int last_idx(int f) const { return max_idx.empty() ? part[f].size() - 1 : max_idx[f]; }
+
     // if wcsp^h sat   -> return true
     // if wcsp^h unsat -> return false & store a set of cores at C (see getCores())
     bool solve(const vector<int> &h, long &time) {
@@ -56,6 +82,8 @@ public:
     }
 
 protected:
+    vector<int> max_idx;        // max_idx[f] == last_idx(f) (empty while nothing is hardened)
+
     // Post: returna índex con mínimo coste que todavía se puede aumentar (es decir
     //        que es diferente de costs[i].size() - 1); -1 en caso de que no haya
     int idx_min_Cost(const vector<int>& k) {
@@ -66,7 +94,7 @@ protected:
         for (int f = 0; f < part.size(); ++f) {
             assert(k[f] < part[f].size());
             Cost cost = part[f][k[f]];
-            if (k[f] < part[f].size() - 1 and cost < min_cost) {
+            if (k[f] < last_idx(f) and cost < min_cost) {
                 min_f = f;
                 min_cost = cost;
             }
@@ -75,7 +75,7 @@ int main(int argc, char const *argv[]) {
         /*for (int f = 0; f < wcsp.nfuncs; f++) {
             cerr << "\t";
             for (int c = 0; c < wcsp.costs[f].size(); c++) {
-                cerr << "-" << csp.solver.failed(-csp.funcICost2lit(f, c)) << "
+                cerr << "-" << csp.solver->failed(-csp.funcICost2lit(f, c)) << "
         ";
             }
             cerr << endl;
@@ -1,11 +1,24 @@
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
 #include <set>
 #include <iostream>
+#include <thread>
 #include <algorithm>
 #include <vector>
+#include <unistd.h>
 #include "csp_sat.hh"
 #include "config.hh"
+#include "budget.hh"
+#include "metrics.hh"
 
 using std::cout;
+using std::map;
 using std::set;
 using std::find;
 using std::vector;
@@ -13,8 +26,8 @@ using std::vector;
 // Post: e_lit not included
 //          ∀x: make clause (x_{s_lit} v x_{s_lit + 1} v ... v x_{e_lit - 1})
 void CSP_sat::at_least_one(int s_lit, int e_lit) {
-    for (int i = s_lit; i < e_lit; ++i) solver.add(i);
-    solver.add(0);
+    for (int i = s_lit; i < e_lit; ++i) add(i);
+    add(0);
 }
 
 // Post: e_lit not included
@@ -22,9 +35,9 @@ void CSP_sat::at_least_one(int s_lit, int e_lit) {
 void CSP_sat::at_most_one(int s_lit, int e_lit) {
     for (int i = s_lit; i < e_lit; ++i) {
         for (int j = i + 1; j < e_lit; ++j) {
-            solver.add(-i);
-            solver.add(-j);
-            solver.add(0); //cerr << endl;
+            add(-i);
+            add(-j);
+            add(0); //cerr << endl;
         }
     }
 }
@@ -34,105 +47,331 @@ void CSP_sat::at_most_one(const vector<int>& literals) {
     int n = literals.size();
     for (int i = 0; i < n - 1; ++i) {
         for (int j = i + 1; j < n; ++j) {
-            solver.add(-literals[i]);
-            solver.add(-literals[j]);
-            solver.add(0);
+            add(-literals[i]);
+            add(-literals[j]);
+            add(0);
         }
     }
 }
 
-vector<int> CSP_sat::build_base_model() {
+// at most one with the sequential (ladder) encoding: 3n clauses, n - 1 aux
+// s_i <=> some of literals[0..i] is true
+void CSP_sat::at_most_one_ladder(const vector<int>& literals) {
+    int n = literals.size();
+    if (n < 2) return;
+    int s = lit_num;
+    lit_num += n - 1;
+    for (int i = 0; i < n; ++i) {
+        if (i < n - 1) {    // x_i -> s_i
+            add(-literals[i]);
+            add(s + i);
+            add(0);
+        }
+        if (i > 0) {        // s_{i-1} -> -x_i
+            add(-(s + i - 1));
+            add(-literals[i]);
+            add(0);
+        }
+        if (i > 0 and i < n - 1) {  // s_{i-1} -> s_i
+            add(-(s + i - 1));
+            add(s + i);
+            add(0);
+        }
+    }
+}
+
+// ladder when compact hard constraints are selected and it is smaller than pairwise
+void CSP_sat::at_most_one_any(const vector<int>& literals) {
+    const int LADDER_MIN = 7;
+    if (HsConfig::compactHard and literals.size() >= LADDER_MIN) at_most_one_ladder(literals);
+    else at_most_one(literals);
+}
+
+void CSP_sat::build_base_model() {
     lit_num = 1;
 
     var2lit = vector<int>(wcsp.nvars);
-    for (int x = 0; x < wcsp.nvars; x++) {
+    for (int i = 0; i < wcsp.nvars; i++) {    // value literals numbered in the variable ordering
+        int x = wcsp.getVar(i);
+        if (wcsp.var2functions[x].empty()) {    // eliminated (see Wcsp::reconstruct)
+            var2lit[x] = NOLIT;
+            continue;
+        }
         // ∀x,a: make atom xa
         //  where x variable, a in domain(x)
         var2lit[x] = lit_num;
         at_least_one(lit_num, lit_num + wcsp.domsize[x]);
-        at_most_one(lit_num, lit_num + wcsp.domsize[x]);
+        vector<int> literals(wcsp.domsize[x]);
+        for (int a = 0; a < wcsp.domsize[x]; ++a) literals[a] = lit_num + a;
         lit_num += wcsp.domsize[x];
+        at_most_one_any(literals);
     }
 
-    vector<int> func2lit = vector<int>(wcsp.nfuncs);
+    func2lit = vector<int>(wcsp.nfuncs);
+    if (incremental) func_act = vector<int>(wcsp.nfuncs);
+    // literals first: then the clauses of the functions are independent
+    const long TASK_TUPLES = 1 << 15;
+    vector<int> tasks = {0};    // first function of each task
+    long tuples = 0;
     for (int f = 0; f < wcsp.nfuncs; f++) {
-        // ∀f,c: make atom f_c
-        //  where f function, c is cost of f, c > 0
-        func2lit[f] = lit_num;
-        lit_num += wcsp.costs[f].size();
-
-        // ∀f,t: make clause (-x1_a1 v -x2_a2 v ... v -xn_an v <block>),
-        //  where t is tuple <a1, a2, ..., an>(cost c) of function f(x1, x2, ..., xn)
-        //      - if c == 0   : <block> = true   i.e. clause not included
-        //      - if c == top : <block> = false  i.e. hard clause (<block> not included)
-        //      - else        : <block> = f_c    i.e. soft clause (<block> assumption)
-        const Function& func = wcsp.functions[f];
-        vector<int> scope = func.getScope();
-        for (int t = 0; t < func.numTuples(); t++) {
-            Cost cost = func.getCost(t);
-            if (cost > 0) {
-                if (cost < wcsp.ub) {
-                    int literal = func2lit[f] + wcsp.cost2index(f, cost);
-                    solver.add(literal);
+        function_lits(f);
+        tuples += wcsp.functions[f].numTuples();
+        if (tuples >= TASK_TUPLES or f == wcsp.nfuncs - 1) {
+            tasks.push_back(f + 1);
+            tuples = 0;
+        }
+    }
+    add_parallel(tasks.size() - 1, [&](int i, vector<int>& out) {
+        for (int f = tasks[i]; f < tasks[i + 1]; ++f) function_clauses(f, out);
+    });
+}
+
+// Post: level literals of f from lit_num on (func2lit[f]). In incremental mode
+//       also the activation literal of its hard clauses (func_act[f])
+void CSP_sat::function_lits(int f) {
+    // ∀f,c: make atom f_c
+    //  where f function, c is cost of f, c > 0
+    func2lit[f] = lit_num;
+    lit_num += wcsp.costs[f].size();
+    if (incremental) func_act[f] = lit_num++;
+}
+
+// Post: clauses of the tuples of f appended to out (0 terminated)
+void CSP_sat::function_clauses(int f, vector<int>& out) const {
+    // ∀f,t: make clause (-x1_a1 v -x2_a2 v ... v -xn_an v <block>),
+    //  where t is tuple <a1, a2, ..., an>(cost c) of function f(x1, x2, ..., xn)
+    //      - if c == 0   : <block> = true   i.e. clause not included
+    //      - if c == top : <block> = false  i.e. hard clause (<block> not included)
+    //      - else        : <block> = f_c    i.e. soft clause (<block> assumption)
+    const Function& func = wcsp.functions[f];
+    const vector<Cost>& costs = wcsp.costs[f];
+    vector<int> scope = func.getScope();
+    for (int t : func.costlyTuples()) {
+        Cost cost = func.getCost(t);
+        if (cost > 0) {
+            if (cost < wcsp.ub) {
+                int idx = std::lower_bound(costs.begin(), costs.end(), cost) - costs.begin();
+                assert(idx < costs.size() and costs[idx] == cost);
+                out.push_back(func2lit[f] + idx);
+            }
+            else if (incremental) out.push_back(-func_act[f]);
+            vector<int> tuple = func.getTuple(t);
+            assert(scope.size() == tuple.size());
+            for (int xf = 0; xf < func.arity(); xf++) {
+                int x = scope[xf];
+                int a = tuple[xf];
+                out.push_back(-varVal2lit(x,a));
+            }
+            out.push_back(0);
+        }
+    }
+}
+
+// Post: f encoded again with new literals (incremental mode)
+void CSP_sat::encode_function(int f) {
+    function_lits(f);
+    vector<int> out;
+    function_clauses(f, out);
+    for (int lit : out) add(lit);
+}
+
+// Post: a chain of compact() steps per cluster; lits[i] is the first literal
+//       and the result i the levels of the sum of cluster i, capped[i] if a
+//       sum >= ub was forbidden. The literals of every step are assigned
+//       first, so the steps are encoded in parallel (see add_parallel). In
+//       incremental mode those sums are guarded by acts[i] (0: none)
+vector<vector<Cost>> CSP_sat::encode_clusters(const vector<vector<int>>& clusters, vector<int>& lits,
+                                              vector<int>& acts, vector<bool>& capped) {
+    int n = clusters.size();
+    vector<vector<vector<Cost>>> levels(n); // levels after each step
+    vector<vector<int>> step_lit(n);        // their first literal
+    vector<pair<int, int>> steps;           // <cluster, step>
+    acts = vector<int>(n, 0);
+    for (int i = 0; i < n; ++i) {
+        const vector<int>& cluster = clusters[i];
+        assert(cluster.size() != 0);
+        if (incremental and cluster.size() > 1) acts[i] = lit_num++;
+        levels[i].push_back(wcsp.costs[cluster[0]]);
+        step_lit[i].push_back(func2lit[cluster[0]]);
+        for (int j = 1; j < cluster.size(); ++j) {
+            vector<Cost> sums = sum_costs(wcsp.ub, levels[i].back(), wcsp.costs[cluster[j]]);
+            step_lit[i].push_back(lit_num);
+            lit_num += sums.size();
+            levels[i].push_back(sums);
+            steps.push_back({i, j});
+        }
+    }
+    vector<char> step_capped(steps.size(), false);
+    add_parallel(steps.size(), [&](int s, vector<int>& out) {
+        // restricciones sobre las dos funciones
+        int i = steps[s].first, j = steps[s].second;
+        int new_f = clusters[i][j];
+        step_capped[s] = compact_step(step_lit[i][j - 1], levels[i][j - 1], func2lit[new_f], wcsp.costs[new_f],
+                                      levels[i][j], step_lit[i][j], acts[i], out);
+    });
+
+    vector<vector<Cost>> result(n);
+    lits = vector<int>(n);
+    capped = vector<bool>(n, false);
+    for (int s = 0; s < steps.size(); ++s) if (step_capped[s]) capped[steps[s].first] = true;
+    for (int i = 0; i < n; ++i) {
+        lits[i] = step_lit[i].back();
+        result[i].swap(levels[i].back());
+    }
+    return result;
+}
+
+// Post: gen(i, out) called for every i in [0, n) by HsConfig::encodeThreads
+//       threads; the clauses out of each i are added to the solver in the
+//       order of i (the encoding does not depend on the number of threads)
+void CSP_sat::add_parallel(int n, const std::function<void(int, vector<int>&)>& gen) {
+    int nthreads = min(HsConfig::encodeThreads, n);
+    vector<int> out;
+    if (nthreads <= 1) {
+        for (int i = 0; i < n; ++i) {
+            out.clear();
+            gen(i, out);
+            for (int lit : out) add(lit);
+        }
+        return;
+    }
+    // the workers fill the buffers; this thread feeds them to the solver.
+    // At most window buffers are pending, which bounds the memory
+    const int window = 4 * nthreads;
+    vector<vector<int>> buffers(n);
+    vector<bool> ready(n, false);
+    int fed = 0;
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::atomic<int> next(0);
+    vector<std::thread> workers;
+    for (int t = 0; t < nthreads; ++t) {
+        workers.emplace_back([&] {
+            int i;
+            while ((i = next++) < n) {
+                {
+                    std::unique_lock<std::mutex> lock(mtx);
+                    cv.wait(lock, [&] { return i < fed + window; });
                 }
-                vector<int> tuple = func.getTuple(t);
-                assert(scope.size() == tuple.size());
-                for (int xf = 0; xf < func.arity(); xf++) {
-                    int x = scope[xf];
-                    int a = tuple[xf];
-                    solver.add(-varVal2lit(x,a));
+                vector<int> clauses;
+                gen(i, clauses);
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    buffers[i].swap(clauses);
+                    ready[i] = true;
                 }
-                solver.add(0);
+                cv.notify_all();
             }
+        });
+    }
+    for (int i = 0; i < n; ++i) {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [&] { return ready[i]; });
+            out.swap(buffers[i]);
         }
+        for (int lit : out) add(lit);
+        vector<int>().swap(out);
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            fed = i + 1;
+        }
+        cv.notify_all();
     }
-    return func2lit;
+    for (std::thread& w : workers) w.join();
 }
 
-vector<Cost> CSP_sat::compact(int lit_num_f1, const vector<Cost>& costs_f1,
-                              int lit_num_f2, const vector<Cost>& costs_f2) {
+// sorted sums a + b < ub of a cost of each list (0 included)
+vector<Cost> CSP_sat::sum_costs(Cost ub, const vector<Cost>& costs_f1, const vector<Cost>& costs_f2) {
     set<Cost> aux = {0};
     for (int idx_a = 0; idx_a < costs_f1.size(); ++idx_a) {
       Cost a = costs_f1[idx_a];
       for (int idx_b = 0; idx_b < costs_f2.size(); ++idx_b) {
           Cost b = costs_f2[idx_b];
-          if (a + b < wcsp.ub) aux.insert(a + b);
+          if (a + b < ub) aux.insert(a + b);
       }
     }
-    vector<Cost> sum_costs(aux.begin(), aux.end());
+    return vector<Cost>(aux.begin(), aux.end());
+}
+
+// clauses added by compact() (levels include cost 0)
+long CSP_sat::compact_clauses(int levels_f1, int levels_f2) {
+    long a = levels_f1 - 1, b = levels_f2 - 1;
+    return a + b + a * b;
+}
+
+vector<Cost> CSP_sat::compact(int lit_num_f1, const vector<Cost>& costs_f1,
+                              int lit_num_f2, const vector<Cost>& costs_f2) {
+    vector<Cost> sum_costs = CSP_sat::sum_costs(wcsp.ub, costs_f1, costs_f2);
+    vector<int> out;
+    if (compact_step(lit_num_f1, costs_f1, lit_num_f2, costs_f2, sum_costs, lit_num, 0, out)) capped = true;
+    for (int lit : out) add(lit);
+    return sum_costs;
+}
+
+// Post: clauses of compact() appended to out, the levels sum_costs from lit_sum
+//       on; true if a sum >= ub was forbidden (guarded by guard_lit if not 0)
+bool CSP_sat::compact_step(int lit_num_f1, const vector<Cost>& costs_f1,
+                           int lit_num_f2, const vector<Cost>& costs_f2,
+                           const vector<Cost>& sum_costs, int lit_sum, int guard_lit, vector<int>& out) const {
+  // index of a sum (sum_costs is sorted)
+  auto idx = [&](Cost c) { return std::lower_bound(sum_costs.begin(), sum_costs.end(), c) - sum_costs.begin(); };
+  bool capped = false;
 
   // generalized totalizer
   for (int idx_a = 1; idx_a < costs_f1.size(); ++idx_a) {  // w + 0 --> w
-      int idx_c = std::find(sum_costs.begin(), sum_costs.end(), costs_f1[idx_a]) - sum_costs.begin();
-      solver.add(-(lit_num_f1 + idx_a));
-      solver.add(lit_num + idx_c);
-      solver.add(0);
+      out.push_back(-(lit_num_f1 + idx_a));
+      out.push_back(lit_sum + idx(costs_f1[idx_a]));
+      out.push_back(0);
   }
   for (int idx_b = 1; idx_b < costs_f2.size(); ++idx_b) { // 0 + w --> w
-      int idx_c = std::find(sum_costs.begin(), sum_costs.end(), costs_f2[idx_b]) - sum_costs.begin();
-      solver.add(-(lit_num_f2 + idx_b));
-      solver.add(lit_num + idx_c);
-      solver.add(0);
+      out.push_back(-(lit_num_f2 + idx_b));
+      out.push_back(lit_sum + idx(costs_f2[idx_b]));
+      out.push_back(0);
   }
   for (int idx_a = 1; idx_a < costs_f1.size(); ++idx_a) {  // w1 + w2 --> w
     for (int idx_b = 1; idx_b < costs_f2.size(); ++idx_b) {
         Cost t = costs_f1[idx_a] + costs_f2[idx_b];
         //assert(t > 0);
-        if (t < wcsp.ub) {
-            int idx_c = std::find(sum_costs.begin(), sum_costs.end(), t) - sum_costs.begin();
-            solver.add(lit_num + idx_c);
+        if (t < wcsp.ub) out.push_back(lit_sum + idx(t));
+        else {
+            capped = true;
+            if (guard_lit != 0) out.push_back(-guard_lit);
         }
-        solver.add(-(lit_num_f1 + idx_a));
-        solver.add(-(lit_num_f2 + idx_b));
-        solver.add(0);
+        out.push_back(-(lit_num_f1 + idx_a));
+        out.push_back(-(lit_num_f2 + idx_b));
+        out.push_back(0);
     }
   }
+  return capped;
+}
+
+const long CSP_sat::EXPLODED;
 
-  return sum_costs;
+// a step whose pairs of levels exceed MAX_PAIRS is not computed: it gets
+// EXPLODED clauses and the levels of the cluster are not estimated (-1)
+vector<long> CSP_sat::estimate_compact(const Wcsp& wcsp, const vector<int>& cluster, int& levels) {
+    const long MAX_PAIRS = 10000000;
+    vector<long> steps;
+    vector<Cost> act_costs = wcsp.costs[cluster[0]];
+    bool exploded = false;
+    for (int j = 1; j < cluster.size(); ++j) {
+        const vector<Cost>& costs_f = wcsp.costs[cluster[j]];
+        if (exploded or (long) act_costs.size() * costs_f.size() > MAX_PAIRS) {
+            exploded = true;
+            steps.push_back(EXPLODED);
+            continue;
+        }
+        steps.push_back(compact_clauses(act_costs.size(), costs_f.size()));
+        act_costs = sum_costs(wcsp.ub, act_costs, costs_f);
+    }
+    levels = exploded ? -1 : act_costs.size();
+    return steps;
 }
 
 // Pre: alldiff or greaterthan
 void CSP_sat::case_study_abstract_core() {
+    PhaseTimer timer(Metrics::encoding);
     cout << "abstract cores case study" << endl;
     assert(wcsp.alldiff or wcsp.greaterthan);
     assert(wcsp.nvars == wcsp.functions.size());
@@ -147,19 +386,19 @@ void CSP_sat::case_study_abstract_core() {
         vector<Cost> act_costs = {0, a};
 
         for (int i = 1; i < N; ++i) {  // sum cost "a" over all functions
-            solver.add(-(part2lit[i] + a));
-            solver.add(lit_num + 1);
-            solver.add(0);    //0 + a --> a
+            add(-(part2lit[i] + a));
+            add(lit_num + 1);
+            add(0);    //0 + a --> a
             for (int j = 1; j < act_costs.size(); ++j) { // w + 0 --> w
-                solver.add(-(act_lit_num + j));
-                solver.add(lit_num + j);
-                solver.add(0);
+                add(-(act_lit_num + j));
+                add(lit_num + j);
+                add(0);
             }
             for (int j = 1; j < act_costs.size(); ++j) { // w + a --> w + a
-                solver.add(-(act_lit_num + j));
-                solver.add(-(part2lit[i] + a));
-                solver.add(lit_num + j + 1);
-                solver.add(0);
+                add(-(act_lit_num + j));
+                add(-(part2lit[i] + a));
+                add(lit_num + j + 1);
+                add(0);
             }
             act_costs.push_back(i*a + a); // i*a is the greatest cost in act_costs
             act_lit_num = lit_num;
@@ -171,6 +410,82 @@ void CSP_sat::case_study_abstract_core() {
     }
     part.pop_back();
     part2lit = part2lit_new;
+    members.clear();    // partitions are costs, not functions
+    part_act = vector<int>(part.size(), 0);
+    part_capped = vector<bool>(part.size(), false);
+}
+
+// Post: unary counter over lits: o_k = out + k (1 <= k <= m) is implied when
+//       at least k of lits are true (k == m: at least m), m = min(|lits|, cap)
+//       (inner leaves are the input literal itself)
+int CSP_sat::totalizer(const vector<int>& lits, int cap, int& m, bool root) {
+    m = min((int) lits.size(), cap);
+    if (lits.size() == 1 and not root) return lits[0] - 1;
+    int out = lit_num;
+    lit_num += m + 1;   // index 0 unused, as in compact()
+    if (lits.size() == 1) {
+        add(-lits[0]);
+        add(out + 1);
+        add(0);
+        return out;
+    }
+    int half = lits.size() / 2;
+    int m1, m2;
+    int out1 = totalizer(vector<int>(lits.begin(), lits.begin() + half), cap, m1, false);
+    int out2 = totalizer(vector<int>(lits.begin() + half, lits.end()), cap, m2, false);
+    for (int i = 0; i <= m1; ++i) {
+        for (int j = 0; j <= m2; ++j) {
+            if (i + j == 0) continue;
+            if (i > 0) add(-(out1 + i));
+            if (j > 0) add(-(out2 + j));
+            add(out + min(i + j, m));
+            add(0);
+        }
+    }
+    return out;
+}
+
+// symbolic merging of general instances: each cluster gets one partition per
+// cost w of its soft functions, a counter over the literals f_w of the base
+// model (levels 0, w, 2w, ...; counts reaching ub are forbidden)
+// Pre: built as orig (one partition per soft function, nothing solved)
+void CSP_sat::abstract_core(const vector<vector<int>>& clusters) {
+    PhaseTimer timer(Metrics::encoding);
+    assert(part.size() == part2lit.size() and max_idx.empty());
+    long clauses = solver->clauses();
+    vector<vector<Cost>> part_new;
+    vector<int> part2lit_new;
+    part_capped.clear();
+    for (const vector<int>& cluster : clusters) {
+        map<Cost, vector<int>> lits;  // <cost, f_cost literals of the cluster>
+        for (int f : cluster) {
+            for (int i = 1; i < wcsp.costs[f].size(); ++i)   // hard functions have no soft costs
+                lits[wcsp.costs[f][i]].push_back(func2lit[f] + i);
+        }
+        for (const auto& w : lits) {
+            int max_count = (wcsp.ub - 1) / w.first;    // count * w < ub
+            int m;
+            int out = totalizer(w.second, max_count + 1, m);
+            part_capped.push_back(m > max_count);
+            if (m > max_count) {   // m == max_count + 1
+                add(-(out + m));
+                add(0);
+                m = max_count;
+            }
+            vector<Cost> levels(m + 1);
+            for (int k = 0; k <= m; ++k) levels[k] = k * w.first;
+            part_new.push_back(levels);
+            part2lit_new.push_back(out);
+        }
+    }
+    part = part_new;
+    part2lit = part2lit_new;
+    members.clear();    // partitions are costs, not functions
+    part_act = vector<int>(part.size(), 0);
+    long levels = 0;
+    for (const vector<Cost>& p : part) levels += p.size();
+    cout << "abstract cores: " << part.size() << ", " << levels << " levels, "
+         << solver->clauses() - clauses << " clauses" << endl;
 }
 
 void CSP_sat::add_hard_alldiff() { // pairwise encoding
@@ -182,7 +497,94 @@ void CSP_sat::add_hard_alldiff() { // pairwise encoding
     for (int a = 0; a < N; ++a) {
         vector<int> literals(N);
         for (int i = 0; i < wcsp.nfuncs; ++i) literals[i] = varVal2lit(i, a);
-        at_most_one(literals);
+        if (HsConfig::compactHard) {
+            at_most_one_ladder(literals);
+            for (int l : literals) add(l);   // N values for N variables: every value is taken
+            add(0);
+        }
+        else at_most_one(literals);
+    }
+}
+
+// comparator with the clauses that bound the outputs by the inputs only
+// (max -> a v b, min -> a, min -> b): true outputs never exceed true inputs.
+// 0 is the constant false
+void CSP_sat::comparator(int a, int b, int& max, int& min) {
+    if (a == 0 or b == 0) {
+        max = a == 0 ? b : a;
+        min = 0;
+        return;
+    }
+    max = lit_num++;
+    min = lit_num++;
+    add(-max); add(a); add(b); add(0);
+    add(-min); add(a); add(0);
+    add(-min); add(b); add(0);
+}
+
+// Batcher's odd-even merge of two sorted (decreasing) sequences of the same
+// power of two size
+vector<int> CSP_sat::merge_sorted(const vector<int>& a, const vector<int>& b) {
+    int n = a.size();
+    assert(b.size() == n and n > 0);
+    vector<int> out(2 * n);
+    if (n == 1) {
+        comparator(a[0], b[0], out[0], out[1]);
+        return out;
+    }
+    vector<int> a_even, a_odd, b_even, b_odd;
+    for (int i = 0; i < n; ++i) {
+        (i % 2 == 0 ? a_even : a_odd).push_back(a[i]);
+        (i % 2 == 0 ? b_even : b_odd).push_back(b[i]);
+    }
+    vector<int> v = merge_sorted(a_even, b_even);
+    vector<int> w = merge_sorted(a_odd, b_odd);
+    out[0] = v[0];
+    for (int i = 0; i < n - 1; ++i) comparator(v[i + 1], w[i], out[2 * i + 1], out[2 * i + 2]);
+    out[2 * n - 1] = w[n - 1];
+    return out;
+}
+
+// sum x_i >= N, O(N^2 log N) clauses: x_i >= k in order encoding (ladder over
+// the domain literals), a tree of merges truncated to N outputs and the N
+// outputs asserted. The merges are complete for sorted inputs and sound for any
+void CSP_sat::add_hard_greater_than_network() {
+    const int N = wcsp.nvars;
+    vector<vector<int>> seqs;
+    for (int i = 0; i < N; ++i) {
+        // u_k -> x_i = k v u_{k+1}, k = 1..N-1 (u_k: x_i >= k)
+        int u = lit_num - 1;
+        lit_num += N - 1;
+        vector<int> seq;
+        for (int k = 1; k < N; ++k) {
+            add(-(u + k));
+            add(varVal2lit(i, k));
+            if (k < N - 1) add(u + k + 1);
+            add(0);
+            seq.push_back(u + k);
+        }
+        seqs.push_back(seq);
+    }
+    while (seqs.size() > 1) {
+        vector<vector<int>> next;
+        for (int i = 0; i + 1 < seqs.size(); i += 2) {
+            int size = 1;
+            while (size < max(seqs[i].size(), seqs[i + 1].size())) size *= 2;
+            vector<int> a = seqs[i], b = seqs[i + 1];
+            a.resize(size, 0);
+            b.resize(size, 0);
+            vector<int> m = merge_sorted(a, b);
+            while (not m.empty() and (m.size() > N or m.back() == 0)) m.pop_back();
+            next.push_back(m);
+        }
+        if (seqs.size() % 2 == 1) next.push_back(seqs.back());
+        seqs.swap(next);
+    }
+    vector<int>& out = seqs[0];
+    if (out.size() < N) add(0);  // the sum cannot reach N
+    else for (int i = 0; i < N; ++i) {
+        add(out[i]);
+        add(0);
     }
 }
 
@@ -198,9 +600,9 @@ void CSP_sat::add_hard_greater_than() {
     for (int i = 0; i < N; ++i) {
         g2lit[i] = lit_num;
         for (int a = 0; a < N; ++a) {
-            solver.add(lit_num + a);
-            solver.add(-varVal2lit(i, a));
-            solver.add(0);
+            add(lit_num + a);
+            add(-varVal2lit(i, a));
+            add(0);
         }
         lit_num += N;
     }
@@ -212,10 +614,10 @@ void CSP_sat::add_hard_greater_than() {
           for (int idx_b = 0; idx_b < N; ++idx_b) {
               Cost t = idx_a + idx_b;
               if (t < N) {
-                  solver.add(lit_num + t);
-                  solver.add(-(act_lit_num + idx_a));
-                  solver.add(-(g2lit[id_f] + idx_b));
-                  solver.add(0);
+                  add(lit_num + t);
+                  add(-(act_lit_num + idx_a));
+                  add(-(g2lit[id_f] + idx_b));
+                  add(0);
               }
           }
         }
@@ -225,69 +627,245 @@ void CSP_sat::add_hard_greater_than() {
 
 
     for (int i = 0; i < N; ++i) {
-        solver.add(-(act_lit_num + i));
-        solver.add(0);
+        add(-(act_lit_num + i));
+        add(0);
     }
 }
 
-CSP_sat::CSP_sat(const Wcsp& wcsp, const vector<vector<int>>& partitions) : CoreCSP(wcsp) { // Partitioning ihs
+CSP_sat::CSP_sat(const Wcsp& wcsp, const vector<vector<int>>& partitions)
+    : CoreCSP(wcsp), solver(SatBackend::create(HsConfig::satBackend)) { // Partitioning ihs
+    PhaseTimer timer(Metrics::encoding);
+    Metrics::satBackend = solver->name();
+
+    incremental = HsConfig::incremental;
+    if (not HsConfig::cacheDir.empty() or not HsConfig::checkpointFile.empty())
+        hash = model_hash(partitions, true);
+    string cache = cache_file();
+    if (load_cache(cache)) return;
+    recording = cache.size() > 0;
 
-    vector<int> func2lit = build_base_model();
-    if (wcsp.greaterthan) add_hard_greater_than();
+    build_base_model();
+    if (wcsp.greaterthan and HsConfig::compactHard) add_hard_greater_than_network();
+    else if (wcsp.greaterthan) add_hard_greater_than();
     else if (wcsp.alldiff) add_hard_alldiff();
 
+    long clauses = solver->clauses();
+    vector<int> lits, acts;
+    vector<bool> capped_sums;
+    vector<vector<Cost>> sums = encode_clusters(partitions, lits, acts, capped_sums);
     part2lit.reserve(partitions.size());
     part.reserve(partitions.size());
     for (int i = 0; i < partitions.size(); ++i) {
-        assert(partitions[i].size() != 0);
-        int id_f = partitions[i][0];
-        if (partitions[i].size() == 1) {
-            if (wcsp.costs[id_f].size() > 1) {  // soft
-                part.push_back(wcsp.costs[id_f]);
-                part2lit.push_back(func2lit[id_f]);
-            }
-        } else {
-            int act_lit_num = func2lit[id_f];
-            vector<Cost> act_costs(wcsp.costs[id_f].begin(), wcsp.costs[id_f].end());
-            for (int j = 1; j < partitions[i].size(); ++j) {
-                // restricciones sobre las dos funciones
-                int new_f = partitions[i][j];
-                act_costs = compact(act_lit_num, act_costs, func2lit[new_f], wcsp.costs[new_f]);
-                act_lit_num = lit_num;
-                lit_num = lit_num + act_costs.size();
-            }
-            if (act_costs.size() > 1) { // soft
-                part2lit.push_back(act_lit_num);
-                part.push_back(act_costs);
-            }
-            assert(act_lit_num + act_costs.size() == lit_num);
+        if (sums[i].size() > 1) { // soft
+            part2lit.push_back(lits[i]);
+            part.push_back(sums[i]);
+            members.push_back(partitions[i]);
+            part_act.push_back(acts[i]);
+            part_capped.push_back(capped_sums[i]);
         }
     }
+    long levels = 0;
+    for (const vector<Cost>& p : part) levels += p.size();
+    cout << "Compact encoding: " << levels << " levels, "
+         << solver->clauses() - clauses << " clauses" << endl;
+    save_cache(cache);
 }
 
-CSP_sat::CSP_sat(const Wcsp& wcsp) : CoreCSP(wcsp) { // orig ihs
-    vector<int> f2lit = build_base_model();
-    assert(f2lit.size() == wcsp.costs.size());
+CSP_sat::CSP_sat(const Wcsp& wcsp) : CoreCSP(wcsp), solver(SatBackend::create(HsConfig::satBackend)) { // orig ihs
+    PhaseTimer timer(Metrics::encoding);
+    Metrics::satBackend = solver->name();
+    incremental = HsConfig::incremental;
+    if (not HsConfig::cacheDir.empty() or not HsConfig::checkpointFile.empty())
+        hash = model_hash({}, false);
+    string cache = cache_file();
+    if (load_cache(cache)) return;
+    recording = cache.size() > 0;
 
-    if (wcsp.greaterthan) add_hard_greater_than();
+    build_base_model();
+    assert(func2lit.size() == wcsp.costs.size());
+
+    if (wcsp.greaterthan and HsConfig::compactHard) add_hard_greater_than_network();
+    else if (wcsp.greaterthan) add_hard_greater_than();
     else if (wcsp.alldiff) add_hard_alldiff();
 
     for (int i = 0; i < wcsp.costs.size(); ++i) {
         if (wcsp.costs[i].size() > 1) { // soft
-            part2lit.push_back(f2lit[i]);
+            part2lit.push_back(func2lit[i]);
             part.push_back(wcsp.costs[i]);
+            members.push_back({i});
+            part_act.push_back(0);
+            part_capped.push_back(false);
         }
     }
 
     assert(part2lit.size() == part.size());
+    save_cache(cache);
+}
+
+// 64-bit FNV-1a
+static void fnv(uint64_t& h, const void* data, size_t n) {
+    const unsigned char* p = (const unsigned char*) data;
+    for (size_t i = 0; i < n; ++i) h = (h ^ p[i]) * 1099511628211ULL;
+}
+
+template <typename T>
+static void fnv(uint64_t& h, const vector<T>& v) {
+    uint64_t n = v.size();
+    fnv(h, &n, sizeof(n));
+    if (n > 0) fnv(h, v.data(), n * sizeof(T));
+}
+
+const uint32_t CACHE_MAGIC = 0x4d485343;  // "MHSC"
+const uint32_t CACHE_VERSION = 2;
+
+// hash of everything the constructor encodes: wcsp, partitions and options
+uint64_t CSP_sat::model_hash(const vector<vector<int>>& partitions, bool partitioned) const {
+    uint64_t h = 14695981039346656037ULL;
+    uint32_t header[] = {CACHE_VERSION, partitioned, wcsp.alldiff, wcsp.greaterthan, HsConfig::compactHard};
+    fnv(h, header, sizeof(header));
+    fnv(h, &wcsp.ub, sizeof(wcsp.ub));
+    fnv(h, wcsp.domsize);
+    fnv(h, wcsp.varOrd);
+    for (int x = 0; x < wcsp.nvars; ++x) {
+        bool elim = wcsp.var2functions[x].empty();
+        fnv(h, &elim, sizeof(elim));
+    }
+    for (int f = 0; f < wcsp.nfuncs; ++f) {
+        const Function& func = wcsp.functions[f];
+        fnv(h, func.getScope());
+        fnv(h, wcsp.costs[f]);
+        for (int t : func.costlyTuples()) {
+            Cost c = func.getCost(t);
+            fnv(h, &t, sizeof(t));
+            fnv(h, &c, sizeof(c));
+        }
+    }
+    for (const vector<int>& p : partitions) fnv(h, p);
+    return h;
+}
+
+// Post: file of the cached encoding, named after hash ("" if there is no cache)
+string CSP_sat::cache_file() const {
+    if (HsConfig::cacheDir.empty() or incremental) return "";
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.cnf", (unsigned long long) hash);
+    return HsConfig::cacheDir + name;
+}
+
+// Post: if file exists, its clauses are added to the solver and the
+//       literal layout (with the members, activation literals and caps of
+//       the partitions, see merge() and update()) is restored; true in that case
+bool CSP_sat::load_cache(const string& file) {
+    if (file.empty()) return false;
+    std::ifstream in(file, std::ios::binary);
+    if (not in.is_open()) return false;
+    uint32_t magic = 0, version = 0;
+    in.read((char*) &magic, sizeof(magic));
+    in.read((char*) &version, sizeof(version));
+    uint64_t nparts = 0;
+    if (not in or magic != CACHE_MAGIC or version != CACHE_VERSION or
+        not in.read((char*) &lit_num, sizeof(lit_num)) or
+        not read_vector(in, var2lit) or not read_vector(in, func2lit) or
+        not read_vector(in, part2lit) or not in.read((char*) &nparts, sizeof(nparts))) {
+        cerr << "Error: invalid encoding cache " << file << endl;
+        exit(EXIT_FAILURE);
+    }
+    part = vector<vector<Cost>>(nparts);
+    for (vector<Cost>& p : part) read_vector(in, p);
+    members = vector<vector<int>>(nparts);
+    for (vector<int>& m : members) read_vector(in, m);
+    vector<char> caps;
+    read_vector(in, part_act);
+    read_vector(in, caps);
+    part_capped.assign(caps.begin(), caps.end());
+    bool fits = part_act.size() == nparts and part_capped.size() == nparts;
+    for (const vector<int>& m : members)
+        for (int f : m) fits = fits and 0 <= f and f < wcsp.nfuncs;
+    if (not in or not fits) {
+        cerr << "Error: invalid encoding cache " << file << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // the clauses are decoded and streamed into the solver
+    const int BLOCK = 1 << 16;
+    vector<unsigned char> bytes(BLOCK);
+    long clauses = 0;
+    uint32_t z = 0;
+    int shift = 0;
+    uint64_t n = 0;
+    in.read((char*) &n, sizeof(n));
+    while (n > 0 and in) {
+        int k = min<uint64_t>(n, BLOCK);
+        in.read((char*) bytes.data(), k);
+        for (int i = 0; i < k; ++i) {
+            z |= (uint32_t) (bytes[i] & 0x7f) << shift;
+            shift += 7;
+            if (bytes[i] & 0x80) continue;
+            int lit = (int) (z >> 1) ^ -(int) (z & 1);
+            solver->add(lit);
+            clauses += lit == 0;
+            z = 0;
+            shift = 0;
+        }
+        n -= k;
+    }
+    if (not in or shift != 0 or part.size() != part2lit.size() or var2lit.size() != wcsp.nvars) {
+        cerr << "Error: truncated encoding cache " << file << endl;
+        exit(EXIT_FAILURE);
+    }
+    long levels = 0;
+    for (const vector<Cost>& p : part) levels += p.size();
+    cout << "Encoding loaded from " << file << ": " << levels << " levels, " << clauses << " clauses" << endl;
+    return true;
+}
+
+void CSP_sat::record(int lit) {
+    uint32_t z = ((uint32_t) lit << 1) ^ (uint32_t) (lit >> 31);
+    while (z >= 0x80) {
+        recorded.push_back((z & 0x7f) | 0x80);
+        z >>= 7;
+    }
+    recorded.push_back(z);
+}
+
+// Post: the recorded clauses and the literal layout are written to file
+//       (through a temporary file, so concurrent runs never read a partial one)
+void CSP_sat::save_cache(const string& file) {
+    if (file.empty()) return;
+    string tmp = file + ".tmp" + std::to_string(getpid());
+    {
+        std::ofstream out(tmp, std::ios::binary);
+        if (not out.is_open()) {
+            cerr << "Warning: encoding cache " << file << " cannot be written" << endl;
+            recording = false;
+            return;
+        }
+        out.write((const char*) &CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        out.write((const char*) &CACHE_VERSION, sizeof(CACHE_VERSION));
+        out.write((const char*) &lit_num, sizeof(lit_num));
+        write_vector(out, var2lit);
+        write_vector(out, func2lit);
+        write_vector(out, part2lit);
+        uint64_t nparts = part.size();
+        out.write((const char*) &nparts, sizeof(nparts));
+        for (const vector<Cost>& p : part) write_vector(out, p);
+        for (const vector<int>& m : members) write_vector(out, m);
+        write_vector(out, part_act);
+        write_vector(out, vector<char>(part_capped.begin(), part_capped.end()));
+        write_vector(out, recorded);
+    }
+    std::rename(tmp.c_str(), file.c_str());
+    recording = false;
+    vector<unsigned char>().swap(recorded);
 }
 
 void CSP_sat::buildSolution() {
-    sol = vector<int>(wcsp.nvars);
+    sol = vector<int>(wcsp.nvars, 0);
     for (int x = 0; x < wcsp.nvars; ++x) {
+        if (var2lit[x] == NOLIT) continue;
         int count = 0;
         for (int a = 0; a < wcsp.domsize[x]; ++a) {
-            if (solver.val(varVal2lit(x,a)) > 0) {
+            if (solver->val(varVal2lit(x,a)) > 0) {
                 sol[x] = a;
                 count++;
             }
@@ -296,16 +874,27 @@ void CSP_sat::buildSolution() {
     }
 }
 
+void CSP_sat::set_phases(const vector<int>& assignment) {
+    for (int x = 0; x < wcsp.nvars; ++x) {
+        if (var2lit[x] == NOLIT) continue;
+        for (int a = 0; a < wcsp.domsize[x]; ++a)
+            solver->phase(a == assignment[x] ? varVal2lit(x,a) : -varVal2lit(x,a));
+    }
+}
 
 // solve wcsp^h
 // if sat   : return true  ,  sol is a solution,   i.e. wcsp^h(sol)=true
 // if unsat : return false ,  C is a set of cores, i.e. C ⊆ {k | h ≤ k, wcsp^k unsat}
+// if the budget is exhausted: return false and interrupted is set
 bool CSP_sat::solve(vector<int> h) {
     assert(h.size() == part.size());
 
     C = vector<vector<int>>(0);
     vector<int> k;
-    while (not solve(h, k)) {
+    int r;
+    while ((r = solve(h, k, false)) == UNSAT) {
+        if (HsConfig::trimConflicts > 0 and HsConfig::hsOption != HS_MIN) trim(k);
+        // core minimization: if a call runs out of budget, k is the last core found
         if (HsConfig::hsOption == HS_MIN) k = h;
         else if (HsConfig::hsOption == HS_GREEDY) { // HS-wcsp_greedy:
             // improve core k
@@ -316,7 +905,7 @@ bool CSP_sat::solve(vector<int> h) {
                 int i = idx_min_Cost(h_);
                 assert(i != -1); // it must be a core
                 ++h_[i];
-            } while (not solve(h_, k));
+            } while (solve(h_, k, true) == UNSAT);
         }
         else if (HsConfig::hsOption == HS_MAX) { // HS-WCSP_max:
             vector<int> k_idx = k;
@@ -325,11 +914,13 @@ bool CSP_sat::solve(vector<int> h) {
                 vector<int> h_ = k;
                 assert(h <= k);
                 ++h_[i];
-                if (solve(h_, k)) k_idx[i] = part[i].size() - 1;
-                else {
+                int r_ = solve(h_, k, true);
+                if (r_ == SAT) k_idx[i] = last_idx(i);
+                else if (r_ == UNSAT) {
                     for (int i = 0; i < k.size(); ++i)
-                        k_idx[i] = k_idx[i] == part[i].size() - 1 ? k_idx[i] : k[i];
+                        k_idx[i] = k_idx[i] >= last_idx(i) ? k_idx[i] : k[i];
                 }
+                else break;
             }
         }
 
@@ -339,36 +930,158 @@ bool CSP_sat::solve(vector<int> h) {
         }
     }
 
+    if (r == UNKNOWN) {
+        interrupted = true;
+        return false;
+    }
     buildSolution(); // optimal solution or ub
+    if (HsConfig::solutionPhases) set_phases(sol);
     return C.empty();
 }
 
 // solve wcsp^h
-// if sat   : return true and k is unchanged
-// if unsat : return false; k is a core (i.e. wcsp^k unsat, h ≤ k)
-bool CSP_sat::solve(const vector<int> &h, vector<int>& k) {
+// if sat     : return SAT and k is unchanged
+// if unsat   : return UNSAT; k is a core (i.e. wcsp^k unsat, h ≤ k)
+// if unknown : return UNKNOWN and k is unchanged (budget exhausted)
+// limited calls (core minimization) are also bounded by the per-call limits
+int CSP_sat::solve(const vector<int> &h, vector<int>& k, bool limited) {
     ++sat_calls;
     assert(h.size() == part.size());
     for (int f = 0; f < part.size(); ++f) {
-        int num_costs = part[f].size();
-        for (int c = 1; c < num_costs; ++c) {
+        int last = last_idx(f); // levels over last are already false
+        for (int c = 1; c <= last; ++c) {
             int sign = (c <= h[f]) ? 1 : -1;
-            solver.assume(sign*partICost2lit(f, c));
+            solver->assume(sign*partICost2lit(f, c));
         }
     }
-    int r = solver.solve();
-    assert(r == 10 or r == 20);
-    bool sat = (r == 10);
-    if (not sat) {
+    for (int a : func_act) solver->assume(a);
+    for (int a : part_act) if (a != 0) solver->assume(a);
+    if (limited and Budget::conflictLimit > 0) solver->limit("conflicts", Budget::conflictLimit);
+    if (limited and Budget::decisionLimit > 0) solver->limit("decisions", Budget::decisionLimit);
+    int r;
+    {
+        PhaseTimer timer(Metrics::satCall);
+        r = solver->solve();
+    }
+    assert(r == SAT or r == UNSAT or r == UNKNOWN);
+    if (r == UNSAT) {
+        PhaseTimer timer(Metrics::smallestFail);
         k = vector<int>(part.size());
         for (int f = 0; f < k.size(); ++f) k[f] = smallestFail(h, f);
         assert(h <= k);
     }
-    return sat;
+    return r;
+}
+
+// Post: k trimmed: solved again under the levels of k alone (only the
+//       failed assumptions restrict the sums), while the core gets smaller.
+//       Each call is limited to HsConfig::trimConflicts conflicts; a call
+//       that is sat or runs out of conflicts leaves the last core
+void CSP_sat::trim(vector<int>& k) {
+    vector<int> k_;
+    while (true) {
+        solver->limit("conflicts", HsConfig::trimConflicts);
+        if (solve(k, k_, false) != UNSAT) break;
+        if (k_.size() == k.size() and std::equal(k_.begin(), k_.end(), k.begin())) break;  // no smaller core
+        k = k_;
+    }
+}
+
+// Post: cost levels c, c + 1, ... of partition f are false in every model
+void CSP_sat::harden(int f, int c) {
+    assert(0 < c and c < part[f].size());
+    if (max_idx.empty()) {
+        max_idx = vector<int>(part.size());
+        for (int i = 0; i < part.size(); ++i) max_idx[i] = part[i].size() - 1;
+    }
+    for (int i = c; i <= max_idx[f]; ++i) {
+        solver->add(-partICost2lit(f, i));
+        solver->add(0);
+    }
+    max_idx[f] = min(max_idx[f], c - 1);
+}
+
+// Post: a totalizer over the level literals of i and j is added to the live
+//       solver; the old literals of i and j are no longer assumed
+bool CSP_sat::merge(int i, int j, int max_levels) {
+    assert(i < j and j < part.size());
+    if (sum_costs(wcsp.ub, part[i], part[j]).size() > max_levels) return false;
+    PhaseTimer timer(Metrics::encoding);
+    int merged_lit = lit_num;
+    capped = false;
+    vector<Cost> merged = compact(part2lit[i], part[i], part2lit[j], part[j]);
+    lit_num += merged.size();
+
+    part[i] = merged;
+    part2lit[i] = merged_lit;
+    part.erase(part.begin() + j);
+    part2lit.erase(part2lit.begin() + j);
+    part_capped[i] = part_capped[i] or part_capped[j] or capped;
+    part_capped.erase(part_capped.begin() + j);
+    part_act.erase(part_act.begin() + j);
+    if (not members.empty()) {
+        members[i].insert(members[i].end(), members[j].begin(), members[j].end());
+        members.erase(members.begin() + j);
+    }
+    if (not max_idx.empty()) {  // hardened levels of i and j are still forbidden by their units
+        max_idx[i] = merged.size() - 1;
+        max_idx.erase(max_idx.begin() + j);
+    }
+    return true;
+}
+
+// Post: the functions in funcs are encoded again with new literals and the
+//       partitions that contain them get new totalizers; the clauses of the
+//       old encoding are disabled through their activation literals, and
+//       hash is that of the edited instance
+vector<int> CSP_sat::update(const vector<int>& funcs) {
+    assert(incremental and max_idx.empty());
+    PhaseTimer timer(Metrics::encoding);
+    long clauses = solver->clauses();
+    vector<int> func2part(wcsp.nfuncs, -1);
+    for (int p = 0; p < members.size(); ++p)
+        for (int f : members[p]) func2part[f] = p;
+
+    vector<int> parts;
+    for (int f : funcs) {
+        if (func2part[f] == -1 and wcsp.costs[f].size() > 1) {
+            cout << "Error: function " << f << " had no soft cost when the solver was built" << endl;
+            exit(0);
+        }
+        add(-func_act[f]);  // old hard clauses are satisfied for ever
+        add(0);
+        encode_function(f);
+        if (func2part[f] != -1 and find(parts.begin(), parts.end(), func2part[f]) == parts.end())
+            parts.push_back(func2part[f]);
+    }
+    vector<vector<int>> clusters;
+    for (int p : parts) {
+        if (part_act[p] != 0) {    // old sums >= ub are allowed
+            add(-part_act[p]);
+            add(0);
+        }
+        clusters.push_back(members[p]);
+    }
+    vector<int> lits, acts;
+    vector<bool> capped_sums;
+    vector<vector<Cost>> levels = encode_clusters(clusters, lits, acts, capped_sums);
+    for (int i = 0; i < parts.size(); ++i) {
+        int p = parts[i];
+        part[p] = levels[i];
+        part2lit[p] = lits[i];
+        part_act[p] = acts[i];
+        part_capped[p] = capped_sums[i];
+    }
+    // the model is no longer the one of the file: checkpoints of the edited
+    // instance must not be resumed by a run over the original one
+    if (hash != 0) hash = model_hash(members, true);
+    cout << "Encoding updated: " << funcs.size() << " functions, " << parts.size() << " partitions, "
+         << solver->clauses() - clauses << " clauses" << endl;
+    return parts;
 }
 
 int CSP_sat::varVal2lit(int var, int val) const {
-    assert(0 <= val and val < wcsp.domsize[var]);
+    assert(0 <= val and val < wcsp.domsize[var] and var2lit[var] != NOLIT);
     return var2lit[var] + val;
 }
 
@@ -384,7 +1097,7 @@ int CSP_sat::smallestFail(const vector<int>& h, int f) {
     assert(h.size() == part.size());
     int num_costs = part[f].size();
     for (int c = h[f] + 1; c < num_costs; c++) {
-        if (solver.failed(-partICost2lit(f,c))) return c - 1;
+        if (solver->failed(-partICost2lit(f,c))) return c - 1;
     }
     return num_costs - 1;
 }
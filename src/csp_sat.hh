@@ -1,42 +1,94 @@
 #ifndef CSPSAT_HH
 #define CSPSAT_HH
 
-#include "sat-cadical/src/cadical.hpp"
+#include <climits>
+#include <functional>
+#include <memory>
 #include "wcsp.hh"
 #include "function.hh"
 #include "csp.hh"
+#include "budget.hh"
+#include "sat_backend.hh"
 
 class CSP_sat : public CoreCSP {
 public:
     CSP_sat(const Wcsp& wcsp);
     CSP_sat(const Wcsp& wcsp, const vector<vector<int>>& partitions);
     bool solve(vector<int> h);
+    void harden(int f, int c);
+    bool merge(int i, int j, int max_levels);
+    vector<int> update(const vector<int>& funcs);
+    void set_phases(const vector<int>& assignment);
+
+    // dry run of the partition constructor over one cluster (no clause is
+    // emitted): clauses of each compact() step, levels of the result
+    static const long EXPLODED = LONG_MAX / 4;  // clauses of a step too large to estimate
+    static vector<long> estimate_compact(const Wcsp& wcsp, const vector<int>& cluster, int& levels);
 
 private:
+    friend class EncodingBench;         // encoding_bench.hh, micro_bench.cc only
     const int NOLIT = -1;
-    CaDiCaL::Solver solver;
+    static const int SAT = SatBackend::SAT, UNSAT = SatBackend::UNSAT, UNKNOWN = SatBackend::UNKNOWN;
+    std::unique_ptr<SatBackend> solver; // HsConfig::satBackend
 
     int lit_num = 1;                    //next avaliable literal
     vector<int> var2lit;
     vector<int> part2lit;
+    vector<int> func2lit;               // first level literal of each function (base model)
+
+    // incremental mode (HsConfig::incremental): hard clauses of each function
+    // and sums >= ub of each partition are guarded by assumed literals
+    bool incremental = false;
+    vector<int> func_act;               // activation literal of each function
+    vector<int> part_act;               // activation literal of each partition (0: none)
+    bool capped = false;                // compact() forbade a sum >= ub
+
+    // encoding cache (HsConfig::cacheDir): clauses of the constructor are recorded
+    bool recording = false;
+    vector<unsigned char> recorded;     // literals as zigzag varints
+    void add(int lit) { solver->add(lit); if (recording) record(lit); }
+    void record(int lit);
+    uint64_t model_hash(const vector<vector<int>>& partitions, bool partitioned) const;
+    string cache_file() const;
+    bool load_cache(const string& file);
+    void save_cache(const string& file);
 
     int varVal2lit(int var, int val) const;
     int partICost2lit(int func, int idx_cost) const;
 
     int smallestFail(const vector<int>& h, int func);
     void buildSolution();
-    vector<int> build_base_model();     // it builds basic SAT model
-    bool solve(const vector<int> &h, vector<int>& k);
+    void build_base_model();            // it builds basic SAT model
+    void function_lits(int f);
+    void function_clauses(int f, vector<int>& out) const;
+    void encode_function(int f);
+    vector<vector<Cost>> encode_clusters(const vector<vector<int>>& clusters, vector<int>& lits,
+                                         vector<int>& acts, vector<bool>& capped);
+    void add_parallel(int n, const std::function<void(int, vector<int>&)>& gen);
+    int solve(const vector<int> &h, vector<int>& k, bool limited);
+    void trim(vector<int>& k);
 
     void at_least_one(int s_lit, int e_lit);
     void at_most_one(int s_lit, int e_lit);
     void at_most_one(const vector<int>& literals);
+    void at_most_one_ladder(const vector<int>& literals);
+    void at_most_one_any(const vector<int>& literals);
+    void comparator(int a, int b, int& max, int& min);
+    vector<int> merge_sorted(const vector<int>& a, const vector<int>& b);
 
+    static vector<Cost> sum_costs(Cost ub, const vector<Cost>& costs_f1, const vector<Cost>& costs_f2);
+    static long compact_clauses(int levels_f1, int levels_f2);
     vector<Cost> compact(int lit_num_f1, const vector<Cost>& costs_f1,
                          int lit_num_f2, const vector<Cost>& costs_f2);
+    bool compact_step(int lit_num_f1, const vector<Cost>& costs_f1,
+                      int lit_num_f2, const vector<Cost>& costs_f2,
+                      const vector<Cost>& sum_costs, int lit_sum, int guard_lit, vector<int>& out) const;
 
     void add_hard_greater_than();
     void add_hard_alldiff();
+    void add_hard_greater_than_network();
     void case_study_abstract_core();
+    void abstract_core(const vector<vector<int>>& clusters);
+    int totalizer(const vector<int>& lits, int cap, int& m, bool root = true);
 };
 #endif
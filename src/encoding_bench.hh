@@ -0,0 +1,32 @@
+#ifndef ENCODING_BENCH_HH
+#define ENCODING_BENCH_HH
+
+#include "csp_sat.hh"
+
+// The encoding primitives of CSP_sat over fresh literals, for micro_bench.cc
+// only (the solver keeps them private). Each call returns the clauses added
+class EncodingBench {
+public:
+    static long clauses(const CSP_sat& csp) { return csp.solver->clauses(); }
+
+    static long compact(CSP_sat& csp, const vector<Cost>& costs_f1, const vector<Cost>& costs_f2) {
+        long before = csp.solver->clauses();
+        int l1 = csp.lit_num;
+        int l2 = l1 + costs_f1.size();
+        csp.lit_num = l2 + costs_f2.size();
+        vector<Cost> sums = csp.compact(l1, costs_f1, l2, costs_f2);
+        csp.lit_num += sums.size();
+        return csp.solver->clauses() - before;
+    }
+
+    static long at_most_one(CSP_sat& csp, int n) {
+        long before = csp.solver->clauses();
+        vector<int> lits(n);
+        for (int i = 0; i < n; ++i) lits[i] = csp.lit_num + i;
+        csp.lit_num += n;
+        csp.at_most_one(lits);
+        return csp.solver->clauses() - before;
+    }
+};
+
+#endif
@@ -19,13 +19,62 @@ using std::set;
 using std::string;
 using std::vector;
 
-Function Function::split(Cost c) {
-    Function f_aux = Function(scope, domsize, 0, top);
-    for (int i = 0; i < costs.size(); ++i) if (costs[i] == c) {
-        f_aux.costs[i] = c;
-        costs[i] = 0;
+Function Function::split(Cost c) { return split(vector<Cost>{c})[0]; }
+
+vector<Function> Function::split(const vector<Cost>& cs) {
+    vector<Function> parts(cs.size(), Function(scope, domsize, 0, top, 0, true));
+    if (sparse) {
+        vector<pair<int, Cost>> kept;
+        for (const pair<int, Cost>& e : entries) {
+            auto it = lower_bound(cs.begin(), cs.end(), e.second);
+            if (it != cs.end() and *it == e.second) parts[it - cs.begin()].entries.push_back(e);
+            else kept.push_back(e);
+        }
+        entries.swap(kept);
     }
-    return f_aux;
+    else {
+        for (int p = 0; p < ntuples; ++p) {
+            Cost c = costAt(p);
+            auto it = lower_bound(cs.begin(), cs.end(), c);
+            if (it != cs.end() and *it == c and c != 0) {
+                parts[it - cs.begin()].entries.push_back(make_pair(p, c));
+                setCost(p, 0);
+            }
+        }
+    }
+    for (Function& f : parts)
+        for (const pair<int, Cost>& e : f.entries) f.updateIsHard(e.second);
+    return parts;
+}
+
+Cost Function::costAt(int p) const {
+  assert(0 <= p and p < ntuples);
+  if (coded) return levels[codes[p]];
+  if (not sparse) return costs[p];
+  auto it = lower_bound(entries.begin(), entries.end(), make_pair(p, (Cost) 0));
+  return (it != entries.end() and it->first == p) ? it->second : 0;
+}
+
+void Function::setCost(int p, Cost c) {
+  assert(0 <= p and p < ntuples);
+  if (coded) {
+    int code = find(levels.begin(), levels.end(), c) - levels.begin();
+    if (code < levels.size() or levels.size() < MAX_LEVELS) {
+      if (code == levels.size()) levels.push_back(c);
+      codes[p] = code;
+      return;
+    }
+    expand(); // one cost too many for a byte
+  }
+  if (not sparse) {
+    costs[p] = c;
+    return;
+  }
+  auto it = lower_bound(entries.begin(), entries.end(), make_pair(p, (Cost) 0));
+  bool found = it != entries.end() and it->first == p;
+  if (c == 0 and found) entries.erase(it);
+  else if (c != 0 and found) it->second = c;
+  else if (c != 0) entries.insert(it, make_pair(p, c));
 }
 
 int Function::tuple2index(const vector<int> &t) const { // flattens a tuple to
@@ -88,9 +137,9 @@ Function Function::sortScope() const {
   vector<int> newdomsize(scope.size());
   for (int i = 0; i < scope.size(); i++)
     newdomsize[i] = domsize[mapping[i]];
-  Function newf(newscope, newdomsize, 0, top);
-  for (int p = 0; p < costs.size(); p++) {
-    Cost c = costs[p];
+  Function newf(newscope, newdomsize, 0, top, 0, sparse);
+  for (int p : costlyTuples()) {
+    Cost c = costAt(p);
     vector<int> t = index2tuple(p);
     vector<int> newt(t.size());
     for (int i = 0; i < t.size(); i++)
@@ -101,7 +150,7 @@ Function Function::sortScope() const {
 }
 
 Function::Function(const vector<int> &s, const vector<int> &d, Cost def,
-                   Cost newtop, int sem) {
+                   Cost newtop, int sem, bool sp) {
   // cout << def << ", " << newtop << endl;
   // assert(def <= newtop);
   def = min(def, newtop); // <--- Emma: algunas instancias VAC tienen un def > top
@@ -118,7 +167,11 @@ Function::Function(const vector<int> &s, const vector<int> &d, Cost def,
   for (int i = 1; i < domsize.size(); i++) {
     offset[i] = offset[i - 1] * domsize[i - 1];
   }
-  costs = vector<Cost>(offset[offset.size() - 1] * domsize[s.size() - 1], def);
+  ntuples = offset[offset.size() - 1] * domsize[s.size() - 1];
+  sparse = sp;
+  coded = false;
+  assert(not sparse or def == 0);
+  if (not sparse) costs = vector<Cost>(ntuples, def);
   // I allow to create functins with some semantics for testing purposes
 
   assert(sem == 0); // Emma
@@ -156,17 +209,17 @@ void Function::show(int level) const {
       std::cout << domsize[i] << " ";
     std::cout << std::endl;
     std::cout << "costs ";
-    for (int i = 0; i < costs.size(); i++)
-      std::cout << costs[i] << " ";
+    for (int i = 0; i < ntuples; i++)
+      std::cout << costAt(i) << " ";
     std::cout << std::endl;
   }
   if (level > 1) {
-    for (int i = 0; i < costs.size(); i++) {
+    for (int i = 0; i < ntuples; i++) {
       vector<int> t = index2tuple(i);
       std::cout << "(";
       for (int j = 0; j < t.size(); j++)
         std::cout << t[j] << ", ";
-      std::cout << ": " << costs[i] << ")";
+      std::cout << ": " << costAt(i) << ")";
       std::cout << std::endl;
     }
   }
@@ -223,16 +276,16 @@ void Function::addCost(const vector<int> &t, Cost c) {
   //cout << c << " " << top << endl;
   //assert(c <= top);
   c = min(c, top); // Emma: alguna instancia pasa
-  costs[tuple2index(t)] = c;
+  setCost(tuple2index(t), c);
   updateIsHard(c);
 }
 
 bool Function::check() const {
   bool zero = false;
-  for (int i = 0; i < costs.size(); i++) {
-    if (costs[i] == 0)
+  for (int i = 0; i < ntuples; i++) {
+    if (costAt(i) == 0)
       zero = true;
-    if (costs[i] > top)
+    if (costAt(i) > top)
       return false;
   }
   return zero;
@@ -244,35 +297,74 @@ void Function::updateTop(Cost newTop) {
   if (newTop < top) {
     top = newTop;
     is_hard = true; // Emma
-    for (int p = 0; p < costs.size(); p++) {
-      if (costs[p] > newTop)
-        costs[p] = newTop;
-      updateIsHard(costs[p]);
+    for (int p : costlyTuples()) {
+      if (costAt(p) > newTop)
+        setCost(p, newTop);
+      updateIsHard(costAt(p));
     }
   }
 }
 
+void Function::raiseTop(Cost newTop) {
+  assert(newTop >= top);
+  if (newTop > top) {
+    for (int p : costlyTuples())
+      if (costAt(p) == top)
+        setCost(p, newTop);
+    top = newTop;
+  }
+}
+
 Cost Function::getMinCost() const {
   Cost min = top;
-  for (int p = 0; p < costs.size(); p++)
-    if (costs[p] < min)
-      min = costs[p];
+  if (sparse and entries.size() < ntuples)
+    return 0;
+  for (int p = 0; p < ntuples; p++)
+    if (costAt(p) < min)
+      min = costAt(p);
   return min;
 }
 
 void Function::substractCost(Cost c) {
   is_hard = true; // Emma
-  for (int p = 0; p < costs.size(); p++) {
-    assert(costs[p] >= c);
-    if (costs[p] < top) {
-      costs[p] = costs[p] - c;
-      updateIsHard(costs[p]); // Emma
+  if (c == 0)
+    return;
+  for (int p = 0; p < ntuples; p++) {
+    assert(costAt(p) >= c);
+    if (costAt(p) < top) {
+      setCost(p, costAt(p) - c);
+      updateIsHard(costAt(p)); // Emma
     }
   }
 }
 
+vector<Cost> Function::minCosts(int var) const {
+  int pos = posVar(var);
+  assert(pos != -1);
+  vector<Cost> m(domsize[pos], top);
+  for (int p = 0; p < ntuples; p++) {
+    int a = (p / offset[pos]) % domsize[pos];
+    m[a] = min(m[a], costAt(p));
+  }
+  return m;
+}
+
+void Function::substractCosts(int var, const vector<Cost> &c) {
+  int pos = posVar(var);
+  assert(pos != -1 and c.size() == domsize[pos]);
+  is_hard = true;
+  for (int p = 0; p < ntuples; p++) {
+    int a = (p / offset[pos]) % domsize[pos];
+    if (costAt(p) < top) {
+      assert(costAt(p) >= c[a]);
+      setCost(p, costAt(p) - c[a]);
+    }
+    updateIsHard(costAt(p));
+  }
+}
+
 Cost Function::getCost(const vector<int> &t) const {
-  return costs[tuple2index(t)];
+  return costAt(tuple2index(t));
 }
 
 Cost Function::getCostAssg(const vector<int> &assg) const {
@@ -281,7 +373,7 @@ Cost Function::getCostAssg(const vector<int> &assg) const {
     assert(assg[scope[i]] != -1);
     t[i] = assg[scope[i]];
   }
-  return costs[tuple2index(t)];
+  return costAt(tuple2index(t));
 }
 
 Cost Function::getCostExtended(const vector<int> &t,
@@ -310,8 +402,11 @@ int Function::posVar(int var) const {
 
 vector<Cost> Function::allCosts() const {
   vector<Cost> l;
-  for (int p = 0; p < costs.size(); p++) {
-    Cost c = costs[p];
+  vector<int> costly = costlyTuples();
+  if (costly.size() < ntuples)
+    l.push_back(0);
+  for (int p : costly) {
+    Cost c = costAt(p);
     if (c != top and find(l.begin(), l.end(), c) == l.end())
       l.push_back(c);
   }
@@ -342,7 +437,7 @@ Function Function::condition(int var, int val) const {
   //cout << "conditioning to var " << var << endl;
   Function f = removeVar(var, 0);
   //cout << "removed" << endl;
-  for (int i = 0; i < costs.size(); i++) {
+  for (int i = 0; i < ntuples; i++) {
     //cout << "   c " << i << endl;
     vector<int> t = index2tuple(i);
     int pos = var2pos.at(var);
@@ -354,7 +449,7 @@ Function Function::condition(int var, int val) const {
       // Cost c = getCost(t);
       t.erase(t.begin() + pos); // var2pos.at(var));
       //
-      f.addCost(t, costs[i]);
+      f.addCost(t, costAt(i));
     }
   }
   return f;
@@ -363,7 +458,7 @@ Function Function::condition(int var, int val) const {
 Function Function::project(int var) const {
   assert(var2pos.find(var) != var2pos.end());
   Function f = removeVar(var, top);
-  for (int i = 0; i < costs.size(); i++) {
+  for (int i = 0; i < ntuples; i++) {
     vector<int> t = index2tuple(i);
     Cost c = getCost(t);
     t.erase(t.begin() + var2pos.at(var));
@@ -412,7 +507,7 @@ Function Function::join(const Function &f) const {
   Function f2(newscope, newdomsize, 0, top,
               0); // will be the resulting funciton
 
-  for (int p = 0; p < f2.costs.size(); p++) { // for every tuple of f2
+  for (int p = 0; p < f2.ntuples; p++) { // for every tuple of f2
     vector<int> t2 = f2.index2tuple(p);
     Cost c_this = getCostExtended(t2, newscope);
     Cost c = f.getCostExtended(t2, newscope);
@@ -427,6 +522,75 @@ Function Function::join(const Function &f) const {
   return f2;
 }
 
-int Function::numTuples() const { return costs.size(); }
-Cost Function::getCost(int idx) const { return costs[idx]; }
+int Function::numTuples() const { return ntuples; }
+Cost Function::getCost(int idx) const { return costAt(idx); }
+
+vector<int> Function::costlyTuples() const {
+  vector<int> l;
+  if (sparse) {
+    l.reserve(entries.size());
+    for (const pair<int, Cost>& e : entries) l.push_back(e.first);
+  }
+  else {
+    for (int p = 0; p < ntuples; p++)
+      if (costAt(p) != 0) l.push_back(p);
+  }
+  return l;
+}
+
+void Function::expand() {
+  vector<Cost> dense(ntuples);
+  for (int p = 0; p < ntuples; p++)
+    dense[p] = costAt(p);
+  costs.swap(dense);
+  vector<pair<int, Cost>>().swap(entries);
+  vector<unsigned char>().swap(codes);
+  vector<Cost>().swap(levels);
+  sparse = coded = false;
+}
+
+// Post: the table is the smallest of: dense (a cost per tuple), sparse (the
+//       tuples with cost != 0) and coded (a byte per tuple indexing levels,
+//       if there are at most MAX_LEVELS distinct costs). Costs do not change
+void Function::shrink() {
+  vector<int> costly = costlyTuples();
+  set<Cost> distinct = {0};
+  for (int p : costly) {
+    distinct.insert(costAt(p));
+    if (distinct.size() > MAX_LEVELS) break;
+  }
+  long dense_bytes = (long) ntuples * sizeof(Cost);
+  long sparse_bytes = (long) costly.size() * sizeof(pair<int, Cost>);
+  long coded_bytes = distinct.size() <= MAX_LEVELS ? ntuples + distinct.size() * sizeof(Cost) : dense_bytes + 1;
+  if (sparse_bytes <= min(dense_bytes, coded_bytes)) {
+    if (sparse) return;
+    vector<pair<int, Cost>> e;
+    e.reserve(costly.size());
+    for (int p : costly) e.push_back(make_pair(p, costAt(p)));
+    vector<Cost>().swap(costs);
+    vector<unsigned char>().swap(codes);
+    vector<Cost>().swap(levels);
+    entries.swap(e);
+    sparse = true;
+    coded = false;
+  }
+  else if (coded_bytes < dense_bytes) {
+    if (coded) return;
+    vector<Cost> l(distinct.begin(), distinct.end());
+    vector<unsigned char> c(ntuples, 0); // levels[0] = 0
+    for (int p : costly) c[p] = lower_bound(l.begin(), l.end(), costAt(p)) - l.begin();
+    vector<Cost>().swap(costs);
+    vector<pair<int, Cost>>().swap(entries);
+    levels.swap(l);
+    codes.swap(c);
+    sparse = false;
+    coded = true;
+  }
+  else if (sparse or coded) expand();
+}
+
+long Function::bytes() const {
+  return costs.capacity() * sizeof(Cost) + entries.capacity() * sizeof(pair<int, Cost>) +
+         codes.capacity() + levels.capacity() * sizeof(Cost);
+}
 vector<int> Function::getTuple(int idx) const { return index2tuple(idx); }
@@ -18,15 +18,27 @@ using std::pair;
 using std::string;
 using std::set;
 
+const int MAX_LEVELS = 256; // distinct costs of a coded table (one byte per tuple)
+
 class Function {// cost functions implemented as a flattened vector of costs
 private:
   vector<int> scope; // list of variables (no order assumed)
   vector<int> domsize; //list of domain sizes
   vector<int> offset; //product of previous domain sizes
   map<int, int> var2pos; //where in the scope is the variable
-  vector<Cost> costs; //cost function
+  vector<Cost> costs; //cost function (empty if sparse)
+  vector<pair<int, Cost>> entries; //sparse: tuples with cost != 0, sorted by index (the rest cost 0)
+  vector<unsigned char> codes; //coded: index in levels of the cost of every tuple
+  vector<Cost> levels; //coded: the distinct costs (at most MAX_LEVELS)
+  bool sparse;
+  bool coded;
+  int ntuples;
   Cost top; // all values in costs must be <= top
 
+  Cost costAt(int p) const; // every access to the costs goes through costAt/setCost
+  void setCost(int p, Cost c);
+  void expand(); // back to the flattened vector of costs
+
   int  tuple2index(const vector<int>& t) const;
   vector<int>  index2tuple(int p) const;
   //bool  indexContains(int p, int var, int val) const;
@@ -37,12 +49,16 @@ private:
   bool is_hard; // Emma
 
 public:
-  Function(const vector<int>& s,const vector<int>& d, Cost def, Cost top, int sem=0);
+  Function(const vector<int>& s,const vector<int>& d, Cost def, Cost top, int sem=0, bool sparse=false);
+  // if sparse --> only the tuples with cost != 0 are stored (def must be 0)
   // if type==0 --> all costs are the default "def"
   // if type==1 --> cost= sum of values
   // if type==2 --> cost= |s|- number of different values
 
   Function split(Cost c); // ha dejado f con las tuplas con coste c a 0, y se las ha puesto a la función que retorna
+  // split for all costs cs (sorted) in one pass: the i-th function returned is
+  // sparse and holds the tuples of cost cs[i], which are set to 0 in f
+  vector<Function> split(const vector<Cost>& cs);
 
   bool sortedScope() const;
   Function sortScope() const;//because the wcsp format may have cost functions whose scope is not ordered, we use this method to order it;
@@ -56,8 +72,11 @@ public:
   Cost getTop() const {return top;}
   bool check() const;// checks costs are between zero and top
   void updateTop(Cost newtop); //decreases all costs higher than newTop
+  void raiseTop(Cost newtop); //increases top, the hard tuples (cost top) stay hard
   Cost getMinCost() const;
   void substractCost(Cost c); //substracts c from every tuple
+  vector<Cost> minCosts(int var) const; //minimum cost of the tuples with var = a, for every a
+  void substractCosts(int var, const vector<Cost>& c); //substracts c[a] from the tuples with var = a (but top)
   Cost getCost(const vector<int>& t) const;// scope(t)==scope(this.scope)
   Cost getCostAssg(const vector<int>& assg) const;
   Cost getCostExtended(const vector<int>& t, const vector<int>& s)const;// scope(t)\superseteq scope(this.scope)
@@ -75,6 +94,10 @@ public:
 
   //
   int numTuples() const;
+  vector<int> costlyTuples() const; // indices of the tuples with cost != 0
+  bool isSparse() const {return sparse;}
+  void shrink(); // keeps the smallest of the dense, sparse and coded tables
+  long bytes() const; // memory of the table
   Cost getCost(int idx) const; // get cost from tuple index
   vector<int> getTuple(int idx) const; // get tuple from tuple index
 
@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include "generator.hh"
+
+using std::cerr;
+using std::endl;
+
+vector<vector<int>> WcspGenerator::scopes() {
+    vector<vector<int>> s;
+    if (p.graph == "grid") {
+        int side = std::ceil(std::sqrt((double) p.nvars));
+        for (int x = 0; x < p.nvars; ++x) {
+            int right = (x % side < side - 1 and x + 1 < p.nvars) ? x + 1 : -1;
+            int down = x + side < p.nvars ? x + side : -1;
+            if (p.arity == 2) {
+                if (right != -1) s.push_back({x, right});
+                if (down != -1) s.push_back({x, down});
+            }
+            else if (right != -1 and down != -1) s.push_back({x, right, down});
+        }
+    }
+    else {
+        std::uniform_int_distribution<int> rnd_var(0, p.nvars - 1);
+        for (int i = 0; i < p.nfuncs; ++i) {
+            set<int> vars;
+            while (vars.size() < p.arity) vars.insert(rnd_var(rng));
+            s.push_back(vector<int>(vars.begin(), vars.end()));
+        }
+    }
+    return s;
+}
+
+// tuples with cost > 0 with probability tightness, costStep * {1..ncosts},
+// forbidden (top) with probability hard; the tuple of the planted assignment costs 0
+// (raised by plant())
+Function WcspGenerator::randomFunction(const vector<int>& scope, const Wcsp& wcsp, Cost top) {
+    vector<int> dom(scope.size());
+    for (int i = 0; i < scope.size(); ++i) dom[i] = wcsp.domsize[scope[i]];
+    Function f(scope, dom, 0, top);
+    std::uniform_real_distribution<double> coin(0, 1);
+    std::uniform_int_distribution<int> level(1, p.ncosts);
+    vector<int> planted_t(scope.size());
+    if (p.planted)
+        for (int i = 0; i < scope.size(); ++i) planted_t[i] = planted_sol[scope[i]];
+    for (int t = 0; t < f.numTuples(); ++t) {
+        if (coin(rng) >= p.tightness) continue;
+        vector<int> tuple = f.getTuple(t);
+        if (p.planted and tuple == planted_t) continue;
+        if (coin(rng) < p.hard) f.addCost(tuple, top);
+        else f.addCost(tuple, p.costStep * level(rng));
+    }
+    return f;
+}
+
+// Post: delta added to the finite costs of f with value a at position pos
+static void addOnValue(Function& f, int pos, int a, Cost delta, Cost top) {
+    for (int t = 0; t < f.numTuples(); ++t) {
+        vector<int> tuple = f.getTuple(t);
+        Cost c = f.getCost(tuple);
+        if (tuple[pos] != a or c >= top) continue;
+        if (c + delta < 0) {
+            cerr << "Error: negative cost while planting" << endl;
+            exit(EXIT_FAILURE);
+        }
+        f.addCost(tuple, c + delta);
+    }
+}
+
+// Post: every function f costs alpha_f in costStep * {1..ncosts} more on its
+//       finite tuples, and then up to alpha_f / arity of f on x = a is moved
+//       to another function of x on x = a, for every x and a. Every
+//       assignment costs the sum of the alphas (returned) more than before
+//       and no cost is negative, so the planted assignment (cost 0 before)
+//       stays optimal; the moves keep the reader's normalization (minimum
+//       cost of each function to lb) from finding that sum
+Cost WcspGenerator::plant(Wcsp& wcsp, Cost top) {
+    std::uniform_int_distribution<int> level(1, p.ncosts);
+    vector<Cost> alpha(wcsp.nfuncs);
+    Cost raise = 0;
+    for (int f = 0; f < wcsp.nfuncs; ++f) {
+        alpha[f] = p.costStep * level(rng);
+        raise += alpha[f];
+        for (int t = 0; t < wcsp.functions[f].numTuples(); ++t) {
+            vector<int> tuple = wcsp.functions[f].getTuple(t);
+            Cost c = wcsp.functions[f].getCost(tuple);
+            if (c < top) wcsp.functions[f].addCost(tuple, c + alpha[f]);
+        }
+    }
+    for (int f = 0; f < wcsp.nfuncs; ++f) {
+        const vector<int> scope = wcsp.functions[f].getScope();
+        for (int i = 0; i < scope.size(); ++i) {
+            int x = scope[i];
+            const vector<int>& fx = wcsp.var2functions[x];
+            if (fx.size() < 2) continue;
+            int g = fx[std::uniform_int_distribution<int>(0, fx.size() - 2)(rng)];
+            if (g == f) g = fx.back();
+            vector<int> scope_g = wcsp.functions[g].getScope();
+            int pos_g = std::find(scope_g.begin(), scope_g.end(), x) - scope_g.begin();
+            std::uniform_int_distribution<Cost> amount(0, alpha[f] / scope.size());
+            for (int a = 0; a < wcsp.domsize[x]; ++a) {
+                Cost beta = amount(rng);
+                addOnValue(wcsp.functions[f], i, a, -beta, top);
+                addOnValue(wcsp.functions[g], pos_g, a, beta, top);
+            }
+        }
+    }
+    return raise;
+}
+
+void WcspGenerator::generate(Wcsp& wcsp, vector<vector<int>>& clusters) {
+    if (p.arity < 2 or p.arity > 3 or p.nvars < p.arity or p.domsize < 1 or p.ncosts < 1) {
+        cerr << "Error: invalid generator parameters" << endl;
+        exit(EXIT_FAILURE);
+    }
+    wcsp = Wcsp();
+    wcsp.nvars = p.nvars;
+    wcsp.domsize = vector<int>(p.nvars, p.domsize);
+    wcsp.var2functions = vector<vector<int>>(p.nvars);
+
+    if (p.planted) {
+        std::uniform_int_distribution<int> val(0, p.domsize - 1);
+        planted_sol = vector<int>(p.nvars);
+        for (int x = 0; x < p.nvars; ++x) planted_sol[x] = val(rng);
+    }
+
+    vector<vector<int>> all_scopes;
+    std::uniform_real_distribution<double> coin(0, 1);
+    for (int x = 0; x < p.nvars; ++x) if (coin(rng) < p.unary) all_scopes.push_back({x});
+    vector<vector<int>> s = scopes();
+    all_scopes.insert(all_scopes.end(), s.begin(), s.end());
+
+    // top > sum of all the finite costs (twice with the raise of planted())
+    Cost top = (p.planted ? 2 : 1) * (Cost) all_scopes.size() * p.ncosts * p.costStep + 1;
+    wcsp.ub = top;
+    for (const vector<int>& scope : all_scopes) {
+        for (int x : scope) wcsp.var2functions[x].push_back(wcsp.functions.size());
+        wcsp.functions.push_back(randomFunction(scope, wcsp, top));
+    }
+    wcsp.nfuncs = wcsp.functions.size();
+
+    if (p.planted) {
+        Cost raise = plant(wcsp, top);
+        planted_cost = wcsp.costAssign(planted_sol);
+        if (planted_cost != raise) {
+            cerr << "Error: the planted assignment costs " << planted_cost << " instead of " << raise << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    int nclusters = (p.nvars + p.clusterSize - 1) / p.clusterSize;
+    clusters = vector<vector<int>>(nclusters);
+    for (int f = 0; f < wcsp.nfuncs; ++f)
+        clusters[wcsp.functions[f].getScope()[0] / p.clusterSize].push_back(f);
+    clusters.erase(std::remove_if(clusters.begin(), clusters.end(),
+                                  [](const vector<int>& c) { return c.empty(); }),
+                   clusters.end());
+}
+
+// same format as the .td.l2r files: function ids of each cluster ending with -1
+void WcspGenerator::writePartitions(const string& fileName, const vector<vector<int>>& clusters) {
+    std::ofstream file(fileName);
+    if (not file.is_open()) {
+        cerr << "Error: File " << fileName << " cannot be opened" << endl;
+        exit(EXIT_FAILURE);
+    }
+    for (const vector<int>& c : clusters) {
+        for (int f : c) file << " " << f;
+        file << " -1" << endl;
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef GENERATOR_HH
+#define GENERATOR_HH
+
+#include <random>
+#include <string>
+#include <vector>
+#include "wcsp.hh"
+
+using std::string;
+using std::vector;
+
+// parameters of the synthetic family (see wcsp_gen -h)
+struct GenParams {
+    int nvars = 100;
+    int domsize = 3;
+    int arity = 2;              // 2 or 3
+    string graph = "random";    // "random" or "grid"
+    int nfuncs = 300;           // functions of arity > 1 (random graphs only)
+    double tightness = 0.3;     // fraction of tuples with cost > 0
+    int ncosts = 5;             // distinct costs 1..ncosts (times costStep)
+    Cost costStep = 1;
+    double hard = 0.0;          // fraction of costed tuples that are forbidden
+    double unary = 1.0;         // probability that a variable has a unary function
+    bool planted = false;       // plant an optimal assignment of known cost (see plant())
+    int clusterSize = 10;       // variables per cluster of the partition file
+    unsigned seed = 0;
+};
+
+// Random wcsp instances over random graphs or grids of binary/ternary functions
+class WcspGenerator {
+public:
+    WcspGenerator(const GenParams& p) : p(p), rng(p.seed) {}
+
+    // Post: wcsp is an instance of the family, functions in .wcsp form (no
+    //       adjustments); clusters groups the functions by their first variable
+    void generate(Wcsp& wcsp, vector<vector<int>>& clusters);
+    // cost of the planted assignment, the optimum (PRE: generate() with planted)
+    Cost plantedCost() const { return planted_cost; }
+    const vector<int>& plantedAssignment() const { return planted_sol; }
+
+    static void writePartitions(const string& fileName, const vector<vector<int>>& clusters);
+
+private:
+    GenParams p;
+    std::mt19937 rng;
+    vector<int> planted_sol;
+    Cost planted_cost = 0;
+
+    vector<vector<int>> scopes();
+    Function randomFunction(const vector<int>& scope, const Wcsp& wcsp, Cost top);
+    Cost plant(Wcsp& wcsp, Cost top);
+};
+
+#endif
@@ -0,0 +1,169 @@
+#include <vector>
+#include <cassert>
+#include "local_search.hh"
+
+using std::vector;
+
+const int MAX_SEEDS = 4;    // pending seeds kept (older ones are dropped)
+const int KICKS = 50;       // perturbations tried from each seed
+const int KICK_VARS = 3;    // variables changed by each perturbation
+
+LocalSearch::LocalSearch(const Wcsp& wcsp)
+    : wcsp(wcsp), ub(wcsp.ub), done(false), rng(0) {}
+
+void LocalSearch::start() {
+    done = false;
+    worker = std::thread(&LocalSearch::run, this);
+}
+
+void LocalSearch::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        done = true;
+    }
+    cv.notify_all();
+    if (worker.joinable()) worker.join();
+}
+
+void LocalSearch::seed(const vector<int>& assign) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (seeds.size() == MAX_SEEDS) seeds.erase(seeds.begin());
+        seeds.push_back(assign);
+    }
+    cv.notify_one();
+}
+
+vector<int> LocalSearch::getSolution() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return best_sol;
+}
+
+void LocalSearch::run() {
+    while (true) {
+        vector<int> assign;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [this] { return done or not seeds.empty(); });
+            if (done) return;
+            assign = seeds.back();
+            seeds.pop_back();
+        }
+        Cost cost = wcsp.costAssign(assign);
+        if (cost < wcsp.ub) search(assign, cost);
+    }
+}
+
+// Post: ub and best_sol updated if cost improves the current ub
+void LocalSearch::publish(const vector<int>& assign, Cost cost) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (cost < ub.load()) {
+        best_sol = assign;
+        ub.store(cost);
+    }
+}
+
+Cost LocalSearch::varCost(const vector<int>& assign, int var) const {
+    Cost c = 0;
+    for (int f : wcsp.var2functions[var]) {
+        Cost aux = wcsp.functions[f].getCostAssg(assign);
+        if (aux >= wcsp.ub) return wcsp.ub;
+        c = c + aux;
+    }
+    return c;
+}
+
+// Post: true if changing var from old_val to assign[var] keeps the hard
+//       side constraint of the case study (alldiff is kept by swap moves)
+bool LocalSearch::keepsSideConstraint(const vector<int>& assign, int var, int old_val) const {
+    if (not wcsp.greaterthan) return true;
+    long s = 0;
+    for (int x = 0; x < wcsp.nvars; ++x) s += assign[x];
+    return assign[var] >= old_val or s >= wcsp.nvars;
+}
+
+// steepest descent: applies the best improving move until none exists
+//  - flips of one variable
+//  - swaps of the values of two variables (alldiff case study)
+Cost LocalSearch::descent(vector<int>& assign, Cost cost) {
+    bool improved = true;
+    while (improved and not done) {
+        improved = false;
+        int best_var = -1, best_val = -1;
+        Cost best_delta = 0;
+        for (int x = 0; x < wcsp.nvars; ++x) {
+            int old_val = assign[x];
+            Cost cur = varCost(assign, x);
+            if (wcsp.alldiff) {
+                for (int y = x + 1; y < wcsp.nvars; ++y) {
+                    Cost cur_y = varCost(assign, y);
+                    std::swap(assign[x], assign[y]);
+                    Cost c = varCost(assign, x);
+                    Cost c_y = varCost(assign, y);
+                    if (c < wcsp.ub and c_y < wcsp.ub and c + c_y - cur - cur_y < best_delta) {
+                        best_delta = c + c_y - cur - cur_y;
+                        best_var = x;
+                        best_val = y;
+                    }
+                    std::swap(assign[x], assign[y]);
+                }
+                continue;
+            }
+            for (int a = 0; a < wcsp.domsize[x]; ++a) if (a != old_val) {
+                assign[x] = a;
+                Cost c = varCost(assign, x);
+                if (c < wcsp.ub and c - cur < best_delta and keepsSideConstraint(assign, x, old_val)) {
+                    best_delta = c - cur;
+                    best_var = x;
+                    best_val = a;
+                }
+            }
+            assign[x] = old_val;
+        }
+        if (best_var != -1) {
+            if (wcsp.alldiff) std::swap(assign[best_var], assign[best_val]);
+            else assign[best_var] = best_val;
+            cost = cost + best_delta;
+            improved = true;
+        }
+    }
+    assert(done or cost == wcsp.costAssign(assign));
+    return cost;
+}
+
+// iterated local search: descent + random perturbations of a few variables
+Cost LocalSearch::search(vector<int>& assign, Cost cost) {
+    cost = descent(assign, cost);
+    publish(assign, cost);
+    if (wcsp.nvars == 0) return cost;
+
+    std::uniform_int_distribution<int> rnd_var(0, wcsp.nvars - 1);
+    for (int k = 0; k < KICKS and not done; ++k) {
+        vector<int> next = assign;
+        Cost next_cost = cost;
+        for (int i = 0; i < KICK_VARS; ++i) {
+            int x = rnd_var(rng);
+            if (wcsp.alldiff) {
+                int y = rnd_var(rng);
+                std::swap(next[x], next[y]);
+                continue;
+            }
+            int old_val = next[x];
+            Cost cur = varCost(next, x);
+            next[x] = std::uniform_int_distribution<int>(0, wcsp.domsize[x] - 1)(rng);
+            Cost c = varCost(next, x);
+            // perturbations never violate hard tuples
+            if (c < wcsp.ub and keepsSideConstraint(next, x, old_val)) next_cost = next_cost + c - cur;
+            else next[x] = old_val;
+        }
+        if (wcsp.alldiff) next_cost = wcsp.costAssign(next);
+        if (next_cost >= wcsp.ub) continue;
+        next_cost = descent(next, next_cost);
+        if (next_cost <= cost) {
+            assign = next;
+            cost = next_cost;
+            publish(assign, cost);
+        }
+    }
+    return cost;
+}
@@ -0,0 +1,48 @@
+#ifndef LOCAL_SEARCH_HH
+#define LOCAL_SEARCH_HH
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "wcsp.hh"
+
+using std::vector;
+
+// Background local search over the wcsp model. It is seeded with the
+// solutions found by the SAT solver and publishes every improved upper bound.
+class LocalSearch {
+public:
+    LocalSearch(const Wcsp& wcsp);
+    ~LocalSearch() { stop(); }
+
+    void start();
+    void stop();
+    // queue a complete assignment as a starting point
+    void seed(const vector<int>& assign);
+    Cost getUB() const { return ub.load(); }
+    vector<int> getSolution();
+
+private:
+    const Wcsp& wcsp;
+    std::thread worker;
+    std::mutex mtx;
+    std::condition_variable cv;
+    vector<vector<int>> seeds;      // pending starting points (only the last ones are kept)
+    vector<int> best_sol;           // best assignment found, cost ub
+    std::atomic<Cost> ub;
+    std::atomic<bool> done;
+    std::mt19937 rng;
+
+    void run();
+    void publish(const vector<int>& assign, Cost cost);
+    Cost search(vector<int>& assign, Cost cost);
+    Cost descent(vector<int>& assign, Cost cost);
+    // cost of the functions involving var, wcsp.ub if some of them is violated
+    Cost varCost(const vector<int>& assign, int var) const;
+    bool keepsSideConstraint(const vector<int>& assign, int var, int old_val) const;
+};
+
+#endif
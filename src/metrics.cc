@@ -0,0 +1,75 @@
+#include <cstdio>
+#include <iostream>
+#include "metrics.hh"
+
+using std::cerr;
+using std::endl;
+
+Histogram::Histogram(const char* name, const char* unit)
+    : name(name), unit(unit), count(0), sum(0), max(0) {
+    for (int b = 0; b < BUCKETS; ++b) buckets[b] = 0;
+}
+
+void Histogram::add(long v) {
+    int b = 0;
+    for (unsigned long x = v > 0 ? v : 0; x > 0 and b < BUCKETS - 1; x >>= 1) ++b;
+    ++buckets[b];
+    ++count;
+    sum += v;
+    if (v > max) max = v;
+}
+
+void Histogram::write(std::ostream& os) const {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "{\"type\":\"histogram\",\"name\":\"%s\",\"unit\":\"%s\","
+             "\"count\":%ld,\"sum\":%ld,\"max\":%ld,\"buckets\":[", name, unit, count, sum, max);
+    os << buf;
+    int last = BUCKETS - 1;   // trailing empty buckets are omitted
+    while (last > 0 and buckets[last] == 0) --last;
+    for (int b = 0; b <= last; ++b) os << (b > 0 ? "," : "") << buckets[b];
+    os << "]}\n";
+}
+
+bool Metrics::enabled = false;
+Histogram Metrics::satCall("sat_call", "us");
+Histogram Metrics::smallestFail("smallest_fail", "us");
+Histogram Metrics::mhvCall("mhv_call", "us");
+Histogram Metrics::coreSize("core_size", "partitions");
+Histogram Metrics::coreWeight("core_weight", "cost");
+Histogram Metrics::encoding("encoding", "us");
+Histogram Metrics::parsing("parsing", "us");
+string Metrics::satBackend = "";
+std::ofstream Metrics::out;
+steady_clock::time_point Metrics::start;
+
+void Metrics::open(const string& fileName) {
+    out.open(fileName);
+    if (not out.is_open()) {
+        cerr << "Error: File " << fileName << " cannot be opened" << endl;
+        exit(EXIT_FAILURE);
+    }
+    enabled = true;
+    start = steady_clock::now();
+}
+
+void Metrics::iteration(int it, Cost lb, Cost ub, int ncores, int nd_cores,
+                        long t_solver, long t_mhv, int sat_calls) {
+    if (not enabled) return;
+    long elapsed = duration_cast<microseconds>(steady_clock::now() - start).count();
+    char buf[256];
+    snprintf(buf, sizeof(buf), "{\"type\":\"iteration\",\"iteration\":%d,\"lb\":%ld,\"ub\":%ld,"
+             "\"cores\":%d,\"nd_cores\":%d,\"t_solver_us\":%ld,\"t_mhv_us\":%ld,"
+             "\"sat_calls\":%d,\"elapsed_us\":%ld}\n",
+             it, lb, ub, ncores, nd_cores, t_solver, t_mhv, sat_calls, elapsed);
+    out << buf;
+}
+
+void Metrics::close() {
+    if (not enabled) return;
+    const Histogram* hs[] = {&parsing, &encoding, &satCall, &smallestFail,
+                             &mhvCall, &coreSize, &coreWeight};
+    out << "{\"type\":\"sat_backend\",\"name\":\"" << satBackend << "\"}\n";
+    for (const Histogram* h : hs) h->write(out);
+    out.close();
+    enabled = false;
+}
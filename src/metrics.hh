@@ -0,0 +1,72 @@
+#ifndef METRICS_HH
+#define METRICS_HH
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include "utils.cc"
+
+using namespace std::chrono;
+using std::string;
+
+// Histogram with fixed power-of-two buckets:
+//   bucket 0 counts v <= 0, bucket b counts 2^(b-1) <= v < 2^b
+class Histogram {
+public:
+    static const int BUCKETS = 48;
+
+    Histogram(const char* name, const char* unit);
+    void add(long v);
+    void write(std::ostream& os) const; // one json record
+
+private:
+    const char* name;
+    const char* unit;
+    long count;
+    long sum;
+    long max;
+    long buckets[BUCKETS];
+};
+
+///machine-readable metrics of a run (jsonl): one record per iteration
+///and the histograms of each phase at the end (see open() and close())
+class Metrics {
+protected:
+    virtual ~Metrics() = 0; // Trick to avoid any instantiation
+public:
+    static bool enabled;
+    static Histogram satCall;       // us per sat call
+    static Histogram smallestFail;  // us computing each core from the failed assumptions
+    static Histogram mhvCall;       // us per mhv call
+    static Histogram coreSize;      // partitions that can hit each core
+    static Histogram coreWeight;    // min cost to hit each core
+    static Histogram encoding;      // us building the sat model
+    static Histogram parsing;       // us reading the instance
+    static string satBackend;       // sat solver timed by satCall and smallestFail
+
+    static void open(const string& fileName);
+    static void iteration(int it, Cost lb, Cost ub, int ncores, int nd_cores,
+                          long t_solver, long t_mhv, int sat_calls);
+    static void close();
+
+private:
+    static std::ofstream out;
+    static steady_clock::time_point start;
+};
+
+// adds the microseconds elapsed during its lifetime to a histogram
+class PhaseTimer {
+public:
+    PhaseTimer(Histogram& h) : h(h) {
+        if (Metrics::enabled) start = steady_clock::now();
+    }
+    ~PhaseTimer() {
+        if (Metrics::enabled)
+            h.add(duration_cast<microseconds>(steady_clock::now() - start).count());
+    }
+private:
+    Histogram& h;
+    steady_clock::time_point start;
+};
+
+#endif
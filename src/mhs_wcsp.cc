@@ -1,8 +1,12 @@
 #include "wcsp_solver.hh"
+#include "csp_sat.hh"
 #include "config.hh"
+#include "budget.hh"
+#include "metrics.hh"
+#include "td.hh"
 #include <random>
-
-HsOption HsConfig::hsOption = HS_GREEDY;
+#include <sys/resource.h>
+#include <thread>
 
 vector<vector<int>> read_partitions(string partition_file, const Wcsp& wcsp) {//int nfuncs) {
     // Particiones que están en partition_file
@@ -12,10 +16,11 @@ vector<vector<int>> read_partitions(string partition_file, const Wcsp& wcsp) {//
       exit(EXIT_FAILURE);
     }
 
-    int nfuncs = wcsp.functions.size();
+    int nfuncs = wcsp.funcMap.size();  // functions of the file (before elimination)
     vector<vector<int>> part;
     part.reserve(nfuncs);
     vector<bool> done(nfuncs, false); // <-- checking
+    vector<bool> taken(wcsp.functions.size(), false); // functions merged by elimination appear once
     int x;
     int fs = 0;
     while (file >> x) {
@@ -26,7 +31,9 @@ vector<vector<int>> read_partitions(string partition_file, const Wcsp& wcsp) {//
             assert(not done[x]);
             done[x] = true;
             ++fs;
-            if (wcsp.costs[x].size() > 1) line.push_back(x);  // soft
+            int f = wcsp.funcMap[x];
+            if (f != -1 and not taken[f] and wcsp.costs[f].size() > 1) line.push_back(f);  // soft
+            if (f != -1) taken[f] = true;
             file >> x;
         }
         if (line.size() > 0) part.push_back(line);
@@ -34,6 +41,8 @@ vector<vector<int>> read_partitions(string partition_file, const Wcsp& wcsp) {//
     file.close();
 
     if (fs != nfuncs) { cout << "ERROR: invalid set of partitions." << endl; exit(0); }
+    for (int f = 0; f < wcsp.functions.size(); ++f)  // added by preprocessing (-ms, -sac, -elim)
+        if (not taken[f] and wcsp.costs[f].size() > 1) part.push_back({f});
 
     cout << "Sizes of original partitions:";
     for (int i = 0; i < part.size(); ++i) cout << " " << part[i].size();
@@ -42,6 +51,37 @@ vector<vector<int>> read_partitions(string partition_file, const Wcsp& wcsp) {//
     return part;
 }
 
+// batches of cost updates: each batch is its number of updates n and n
+// lines "f a1 ... ar delta" (function of the file, tuple of its scope, cost increment)
+vector<vector<CostDelta>> read_deltas(string deltas_file, const Wcsp& wcsp) {
+    fstream file(deltas_file);
+    if (not file.is_open()) {
+      cerr << "Error: File " << deltas_file << " cannot be opened" << endl;
+      exit(EXIT_FAILURE);
+    }
+    vector<vector<CostDelta>> batches;
+    int n;
+    while (file >> n) {
+        vector<CostDelta> batch(n);
+        for (CostDelta& d : batch) {
+            file >> d.func;
+            if (not file or d.func < 0 or d.func >= wcsp.nfuncs) {
+                cout << "Error: invalid function in " << deltas_file << endl;
+                exit(0);
+            }
+            d.tuple = vector<int>(wcsp.functions[d.func].arity());
+            for (int& a : d.tuple) file >> a;
+            file >> d.delta;
+        }
+        if (not file) {
+            cout << "Error: truncated batch in " << deltas_file << endl;
+            exit(0);
+        }
+        batches.push_back(batch);
+    }
+    return batches;
+}
+
 void restrict_size(vector<vector<int>>& part, int m_size) {
     if (m_size  == -1) return;
 
@@ -57,25 +97,124 @@ void restrict_size(vector<vector<int>>& part, int m_size) {
     cout << endl;
 }
 
+// Post: clusters are cut into consecutive pieces so that the estimated
+//       compact() clauses of all of them fit in budget and no step explodes:
+//       the most expensive merge step is cut first
+void restrict_encoding(vector<vector<int>>& part, const Wcsp& wcsp, long budget) {
+    vector<vector<long>> steps(part.size());
+    vector<int> levels(part.size());
+    long total = 0;     // clauses of the steps that do not explode
+    int unbounded = 0;  // steps that explode
+    auto count = [&](const vector<long>& s, int sign) {
+        for (long c : s) {
+            if (c == CSP_sat::EXPLODED) unbounded += sign;
+            else total += sign * c;
+        }
+    };
+    for (int i = 0; i < part.size(); ++i) {
+        steps[i] = CSP_sat::estimate_compact(wcsp, part[i], levels[i]);
+        count(steps[i], 1);
+    }
+    int cuts = 0;
+    while (unbounded > 0 or total > budget) {
+        int best_i = -1, best_j = -1;
+        for (int i = 0; i < part.size(); ++i)
+            for (int j = 0; j < steps[i].size(); ++j)
+                if (best_i == -1 or steps[i][j] > steps[best_i][best_j]) {
+                    best_i = i;
+                    best_j = j;
+                }
+        assert(best_i != -1);
+        // step j adds function j + 1 of the cluster
+        vector<int> tail(part[best_i].begin() + best_j + 1, part[best_i].end());
+        part[best_i].erase(part[best_i].begin() + best_j + 1, part[best_i].end());
+        part.push_back(tail);
+        for (int i : {best_i, (int) part.size() - 1}) {
+            if (i < steps.size()) count(steps[i], -1);
+            else {
+                steps.push_back({});
+                levels.push_back(0);
+            }
+            steps[i] = CSP_sat::estimate_compact(wcsp, part[i], levels[i]);
+            count(steps[i], 1);
+        }
+        ++cuts;
+    }
+
+    long nlevels = 0;
+    bool exact = true;
+    for (int i = 0; i < part.size(); ++i) {
+        if (levels[i] == -1) exact = false;
+        else if (levels[i] > 1) nlevels += levels[i]; // soft
+    }
+    cout << "Partitions cut " << cuts << " times for a budget of " << budget << " clauses:";
+    for (int i = 0; i < part.size(); ++i) cout << " " << part[i].size();
+    cout << endl;
+    cout << "Predicted compact encoding: " << nlevels << (exact ? "" : "+") << " levels, ";
+    if (unbounded > 0) cout << "unbounded clauses" << endl;
+    else cout << total << " clauses" << endl;
+}
+
+const int BYTES_PER_CLAUSE = 40;    // estimated memory of a short clause in CaDiCaL
+const int SAC_MAX_PASSES = 100;     // passes of -sac (usually it stops earlier)
+
 void printHelp(string p) {
     cout << "USAGE:" << endl;
     cout << "\t" << p << " -f filename [options]" << endl;
     cout << "\t\t -p partition_file : file with functions in each partition" << endl;
     cout << "\t\t\t if partition_file == 'none' then bacchus and globals compacted" << endl;
     cout << "\t\t\t if partition_file == 'all' all functions in one cluster" << endl;
+    cout << "\t\t\t if partition_file == 'minfill' or 'mindegree' clusters of a tree decomposition computed with that heuristic" << endl;
+    cout << "\t\t -ms : merge the functions with the same scope or a scope included in another one (before encoding)" << endl;
+    cout << "\t\t -sac : soft arc consistency, moves costs to the lower bound (before encoding)" << endl;
+    cout << "\t\t -elim n : eliminate the variables whose functions join into at most n tuples (before encoding)" << endl;
+    cout << "\t\t -stream : shrink every table as it is read and after preprocessing (sparse, or one byte per tuple if at most " << MAX_LEVELS << " costs)" << endl;
+    cout << "\t\t -tdtime seconds : time limit of the min-fill heuristic (default 10)" << endl;
     cout << "\t\t -s int : max size de las particiones (default: -1 ==> w/o restriction)"  << endl;
+    cout << "\t\t -s auto : cut the partitions where the estimated encoding exceeds the budget (see -clauses, -mem)"  << endl;
+    cout << "\t\t -clauses n : clause budget of -s auto for merging the partitions (default 5000000)"  << endl;
+    cout << "\t\t -mem MB : memory budget of -s auto (about " << BYTES_PER_CLAUSE << " bytes per clause)"  << endl;
     cout << "\t\t -ac : abstract cores" << endl;
     cout << "\t\t\t sólo tiene sentido si se indica -p : agrupa por pesos estratificados las funciones del cluster" << endl;
+    cout << "\t\t -act : abstract cores as one totalizer per cluster and cost over the literals of the base model" << endl;
+    cout << "\t\t -j n : threads generating the clauses of the encoding (default 1, 0: one per core)" << endl;
+    cout << "\t\t -trim n : solve again under the failed levels of each core until it stops shrinking, n conflicts per call (default 0: no trimming)" << endl;
+    cout << "\t\t -phase : the sat calls try first the values of the last sat solution (or of a better incumbent)" << endl;
+    cout << "\t\t -order degree|td : value literals numbered by decreasing degree or from the root of a min-fill tree decomposition" << endl;
+    cout << "\t\t -sat backend : incremental sat solver: cadical (default), cadical:option=value,... or ipasir:library.so" << endl;
+    cout << "\t\t -cache dir : reuse the SAT encoding stored in dir by a run over the same instance, partitions and options" << endl;
+    cout << "\t\t -deltas file : after solving, applies each batch of cost updates of file and solves again" << endl;
+    cout << "\t\t\t (batch: n, then n lines 'function tuple delta'; only the edited partitions are encoded again)" << endl;
+    cout << "\t\t -ckpt file : resume from file if it exists (same instance and partitions), and save cores, bounds and incumbent to it" << endl;
+    cout << "\t\t -ckptint seconds : time between checkpoints (default 60; also saved when interrupted)" << endl;
     cout << "\t\t -g n type: case study problem generator" << endl;
     cout << "\t\t\t n : int (number of variables)" << endl;
     cout << "\t\t\t type : int (= 0: all diferent; = 1: greater than)" << endl;
+    cout << "\t\t -ch : compact hard constraints (ladder at-most-one, sorting-network sum for greater than)" << endl;
     cout << "\t\t -t number: hs-min = 1, hs-lazy = 2, hs-greedy = 3 (default), hs-max = 4" << endl;
+    cout << "\t\t -ls : local search thread improving the ub from the sat solutions" << endl;
+    cout << "\t\t -hard : forbid cost levels that cannot improve the ub (hardening)" << endl;
+    cout << "\t\t -rc : reduced-cost fixing of cost levels from the mhv lp relaxation" << endl;
+    cout << "\t\t -merge n : merge two partitions during search once they appear together in n cores" << endl;
+    cout << "\t\t -time seconds : wall-clock limit (best ub and lb are printed on expiry or SIGINT/SIGTERM)" << endl;
+    cout << "\t\t -conflicts n : conflict limit of each core-minimization sat call" << endl;
+    cout << "\t\t -decisions n : decision limit of each core-minimization sat call" << endl;
+    cout << "\t\t -metrics file : jsonl metrics (one record per iteration + phase histograms)" << endl;
 }
 
 int main(int argc, char const *argv[]) {
-    string filename, partition_file;
+    string filename, partition_file, metrics_file, deltas_file, var_order;
     int p_size = -1;
+    bool p_auto = false;
+    long clause_budget = 5000000;
+    double mem_budget = 0;
+    double td_time = 10;
+    long elim_tuples = 0;
+    bool soft_ac = false;
+    bool merge_scopes = false;
+    bool stream_tables = false;
     bool abstract_core = false;
+    bool ac_totalizer = false;
     bool generator = false;
     int gen_type = -1;
     int gen_n = -1;
@@ -87,9 +226,38 @@ int main(int argc, char const *argv[]) {
         }
         else if (strcmp(argv[i],"-f") == 0) filename = argv[i + 1];
         else if (strcmp(argv[i],"-p") == 0) partition_file = argv[i + 1];
-        else if (strcmp(argv[i],"-s") == 0) p_size = atoi(argv[i + 1]);
+        else if (strcmp(argv[i],"-tdtime") == 0) td_time = atof(argv[i + 1]);
+        else if (strcmp(argv[i],"-ms") == 0) merge_scopes = true;
+        else if (strcmp(argv[i],"-stream") == 0) stream_tables = true;
+        else if (strcmp(argv[i],"-sac") == 0) soft_ac = true;
+        else if (strcmp(argv[i],"-elim") == 0) elim_tuples = atol(argv[i + 1]);
+        else if (strcmp(argv[i],"-s") == 0) {
+            if (strcmp(argv[i + 1],"auto") == 0) p_auto = true;
+            else p_size = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i],"-clauses") == 0) clause_budget = atol(argv[i + 1]);
+        else if (strcmp(argv[i],"-mem") == 0) mem_budget = atof(argv[i + 1]);
         else if (strcmp(argv[i],"-ac") == 0) abstract_core = true;
+        else if (strcmp(argv[i],"-act") == 0) abstract_core = ac_totalizer = true;
         else if (strcmp(argv[i],"-t") == 0) HsConfig::hsOption = static_cast<HsOption>(atoi(argv[i + 1]));
+        else if (strcmp(argv[i],"-ls") == 0) HsConfig::localSearch = true;
+        else if (strcmp(argv[i],"-ch") == 0) HsConfig::compactHard = true;
+        else if (strcmp(argv[i],"-hard") == 0) HsConfig::hardening = true;
+        else if (strcmp(argv[i],"-rc") == 0) HsConfig::rcFixing = true;
+        else if (strcmp(argv[i],"-j") == 0) HsConfig::encodeThreads = atoi(argv[i + 1]);
+        else if (strcmp(argv[i],"-trim") == 0) HsConfig::trimConflicts = atoi(argv[i + 1]);
+        else if (strcmp(argv[i],"-phase") == 0) HsConfig::solutionPhases = true;
+        else if (strcmp(argv[i],"-order") == 0) var_order = argv[i + 1];
+        else if (strcmp(argv[i],"-sat") == 0) HsConfig::satBackend = argv[i + 1];
+        else if (strcmp(argv[i],"-cache") == 0) HsConfig::cacheDir = argv[i + 1];
+        else if (strcmp(argv[i],"-deltas") == 0) deltas_file = argv[i + 1];
+        else if (strcmp(argv[i],"-ckpt") == 0) HsConfig::checkpointFile = argv[i + 1];
+        else if (strcmp(argv[i],"-ckptint") == 0) HsConfig::checkpointInterval = atof(argv[i + 1]);
+        else if (strcmp(argv[i],"-merge") == 0) HsConfig::mergeThreshold = atoi(argv[i + 1]);
+        else if (strcmp(argv[i],"-time") == 0) Budget::timeLimit = atof(argv[i + 1]);
+        else if (strcmp(argv[i],"-conflicts") == 0) Budget::conflictLimit = atoi(argv[i + 1]);
+        else if (strcmp(argv[i],"-decisions") == 0) Budget::decisionLimit = atoi(argv[i + 1]);
+        else if (strcmp(argv[i],"-metrics") == 0) metrics_file = argv[i + 1];
         else if (strcmp(argv[i],"-g") == 0) {
             generator = true;
             gen_n = atoi(argv[i + 1]);
@@ -127,6 +295,25 @@ int main(int argc, char const *argv[]) {
         }
     }
 
+    if (var_order.size() > 0 and (generator or (var_order != "degree" and var_order != "td"))) {
+        cout << "Error: -order is degree or td, and needs -f" << endl;
+        exit(0);
+    }
+
+    if (deltas_file.size() > 0) {
+        if (generator or merge_scopes or soft_ac or elim_tuples > 0 or abstract_core or
+            HsConfig::mergeThreshold > 0 or HsConfig::hardening or HsConfig::rcFixing) {
+            cout << "Error: -deltas is incompatible with -g -ms -sac -elim -ac -act -merge -hard -rc" << endl;
+            exit(0);
+        }
+        HsConfig::incremental = true;
+    }
+
+    if (HsConfig::encodeThreads <= 0) HsConfig::encodeThreads = max(1u, std::thread::hardware_concurrency());
+
+    Budget::start();
+    if (metrics_file.size() > 0) Metrics::open(metrics_file);
+
     Wcsp wcsp;
     WcspSolver* solver = nullptr;
 
@@ -140,11 +327,29 @@ int main(int argc, char const *argv[]) {
         }
         else {  // orig or symbolic merging
             solver = new WcspSolver(wcsp);
-            if (abstract_core) solver->case_study_abstract_core(); // symbolic merging of all functions
+            if (ac_totalizer) {
+                vector<vector<int>> all(1);
+                for (int i = 0; i < wcsp.nfuncs; ++i) all[0].push_back(i);
+                solver->abstract_core(all);
+            }
+            else if (abstract_core) solver->case_study_abstract_core(); // symbolic merging of all functions
         }
     }
     else {  // instance file
-        wcsp.read(filename);
+        {
+            PhaseTimer timer(Metrics::parsing);
+            wcsp.read(filename, stream_tables);
+            if (merge_scopes) wcsp.merge_scopes();
+            if (soft_ac) wcsp.soft_ac(SAC_MAX_PASSES);
+            if (elim_tuples > 0) wcsp.eliminate(elim_tuples);
+            if (stream_tables) cout << "Tables: " << wcsp.shrink_tables() / 1024 << " KB" << endl;
+        }
+        if (var_order == "degree") wcsp.sortVariables();
+        else if (var_order == "td") {
+            TreeDecomposition td(wcsp);
+            td.decompose(TD_MIN_FILL, td_time);
+            wcsp.varOrd = td.root_order();
+        }
         if (partition_file.size() == 0) solver = new WcspSolver(wcsp); // orig
         else {
             vector<vector<int>> part;
@@ -155,12 +360,31 @@ int main(int argc, char const *argv[]) {
             else if (partition_file == "none") {
                 for (int i = 0; i < wcsp.nfuncs; ++i) part.push_back({i});
             }
+            else if (partition_file == "minfill" or partition_file == "mindegree") {
+                TreeDecomposition td(wcsp);
+                td.decompose(partition_file == "minfill" ? TD_MIN_FILL : TD_MIN_DEGREE, td_time);
+                part = td.clusters();
+                cout << "Tree decomposition (" << partition_file << ") width " << td.width() << ", sizes of partitions:";
+                for (int i = 0; i < part.size(); ++i) cout << " " << part[i].size();
+                cout << endl;
+            }
             else part = read_partitions(partition_file, wcsp);
             restrict_size(part, p_size);
+            if (p_auto) {
+                long budget = clause_budget;
+                if (mem_budget > 0) budget = min(budget, (long) (mem_budget * 1024 * 1024 / BYTES_PER_CLAUSE));
+                restrict_encoding(part, wcsp, budget);
+            }
 
-            if (abstract_core) part = wcsp.partition_abstract_core(part); // symbolic over partitions
-                                                                          // else numerical over partitions
-            solver = new WcspSolver(wcsp, part);
+            if (ac_totalizer) {  // symbolic over partitions, counters over the base model
+                solver = new WcspSolver(wcsp);
+                solver->abstract_core(part);
+            }
+            else {
+                if (abstract_core) part = wcsp.partition_abstract_core(part); // symbolic over partitions
+                                                                              // else numerical over partitions
+                solver = new WcspSolver(wcsp, part);
+            }
         }
     }
     assert(solver);
@@ -168,9 +392,30 @@ int main(int argc, char const *argv[]) {
     auto start = high_resolution_clock::now();
     Cost opt = solver->solve();
     auto stop = high_resolution_clock::now();
-    delete solver;
+    bool optimal = solver->isOptimal();
 
     auto duration = duration_cast<microseconds>(stop - start);
     double time = duration.count() / 1000000.0;
-    cout << "Optimum: " << opt << " in " << time << " seconds." << endl;
+    if (optimal) cout << "Optimum: " << opt << " in " << time << " seconds." << endl;
+    else cout << "Lower bound: " << opt << " in " << time << " seconds (interrupted)." << endl;
+
+    if (deltas_file.size() > 0 and optimal) {
+        vector<vector<CostDelta>> batches = read_deltas(deltas_file, wcsp);
+        for (int b = 0; b < batches.size() and optimal; ++b) {
+            start = high_resolution_clock::now();
+            wcsp.apply(batches[b]);
+            opt = solver->resolve(batches[b]);
+            stop = high_resolution_clock::now();
+            optimal = solver->isOptimal();
+            time = duration_cast<microseconds>(stop - start).count() / 1000000.0;
+            if (optimal) cout << "Optimum after update " << b + 1 << ": " << opt << " in " << time << " seconds." << endl;
+            else cout << "Lower bound after update " << b + 1 << ": " << opt << " in " << time << " seconds (interrupted)." << endl;
+        }
+    }
+    delete solver;
+    Metrics::close();
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    cout << "Peak memory: " << usage.ru_maxrss << " KB" << endl;
 }
@@ -0,0 +1,255 @@
+// Micro-benchmarks of the Function table operations and the SAT encoding
+// primitives of CSP_sat, on synthetic tables or on the tables of an instance.
+//
+//   micro_bench [-a arities] [-d domsizes] [-c costs] [-z density] [-r reps] [-seed n]
+//   micro_bench -f instance.wcsp [-r reps]
+//
+// lists are comma separated, e.g. -a 2,3,4 -d 2,8
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <vector>
+#include "wcsp.hh"
+#include "function.hh"
+#include "csp_sat.hh"
+#include "encoding_bench.hh"
+
+using namespace std::chrono;
+using std::vector;
+
+class MicroBench {
+public:
+    int reps = 3;
+    std::mt19937 rng;
+    // if not null, report_tuples() / report_clauses() accumulate <tuples, ns> /
+    // <clauses, ns> instead of printing
+    std::map<string, pair<long, double>>* acc = nullptr;
+    std::map<string, pair<long, double>>* acc_clauses = nullptr;
+
+    MicroBench(int seed) : rng(seed) {}
+
+    // random table: a tuple has a cost != 0 with probability density,
+    // costs taken from {1, ..., ncosts}
+    Function random_function(const vector<int>& scope, const vector<int>& dom,
+                             int ncosts, double density, Cost top) {
+        Function f(scope, dom, 0, top);
+        std::uniform_real_distribution<double> coin(0, 1);
+        std::uniform_int_distribution<int> cost(1, ncosts);
+        for (int t = 0; t < f.numTuples(); ++t)
+            if (coin(rng) < density) f.addCost(f.getTuple(t), cost(rng));
+        return f;
+    }
+
+    static const Cost SINGLE_UB = 1L << 40;
+
+    // one-function wcsp over variables 0..arity-1 (ub high enough for every sum of costs)
+    Wcsp single_wcsp(const Function& f, const vector<int>& dom) {
+        Wcsp w;
+        w.nvars = dom.size();
+        w.nfuncs = 1;
+        w.ub = SINGLE_UB;
+        w.domsize = dom;
+        w.functions = {f};
+        w.var2functions = vector<vector<int>>(w.nvars, {0});
+        vector<Cost> cs = f.allCosts();
+        if (cs.empty() or cs[0] != 0) cs.insert(cs.begin(), 0);
+        w.costs = {cs};
+        w.varOrd = vector<int>(w.nvars);
+        for (int i = 0; i < w.nvars; ++i) w.varOrd[i] = i;
+        return w;
+    }
+
+    // best time (ns) of reps executions of op
+    template <typename Op>
+    double time_ns(Op op) {
+        double best = -1;
+        for (int r = 0; r < reps; ++r) {
+            auto start = steady_clock::now();
+            op();
+            double t = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+            if (best < 0 or t < best) best = t;
+        }
+        return best;
+    }
+
+    void report_tuples(const string& op, const string& params, long tuples, double ns) {
+        if (acc) {
+            pair<long, double>& a = (*acc)[op + "\t" + params];
+            a.first += tuples;
+            a.second += ns;
+            return;
+        }
+        cout << op << "\t" << params << "\ttuples " << tuples
+             << "\tns/tuple " << (tuples > 0 ? ns / tuples : 0) << endl;
+    }
+
+    void report_clauses(const string& op, const string& params, long clauses, double ns) {
+        if (acc_clauses) {
+            pair<long, double>& a = (*acc_clauses)[op + "\t" + params];
+            a.first += clauses;
+            a.second += ns;
+            return;
+        }
+        cout << op << "\t" << params << "\tclauses " << clauses
+             << "\tclauses/s " << (ns > 0 ? clauses / (ns / 1e9) : 0) << endl;
+    }
+
+    void bench_function(const Function& f, const string& params) {
+        const vector<int> scope = f.getScope();
+        int nvars = scope.back() + 1;
+        long n = f.numTuples();
+
+        vector<vector<int>> assgs(n, vector<int>(nvars, 0));
+        for (int t = 0; t < n; ++t) {
+            vector<int> tuple = f.getTuple(t);
+            for (int i = 0; i < scope.size(); ++i) assgs[t][scope[i]] = tuple[i];
+        }
+        volatile Cost sink = 0;
+        report_tuples("getCostAssg", params, n, time_ns([&] {
+            for (const vector<int>& a : assgs) sink = sink + f.getCostAssg(a);
+        }));
+        int var = scope[0];
+        if (scope.size() > 1) { // functions with empty scope are not supported
+            report_tuples("condition", params, n, time_ns([&] { f.condition(var, 0); }));
+            report_tuples("project", params, n, time_ns([&] { f.project(var); }));
+            Function g = f.project(var);
+            long m = 0;
+            double ns = time_ns([&] { m = f.join(g).numTuples(); });
+            report_tuples("join", params, m, ns);
+        }
+    }
+
+    void bench_sortScope(const vector<int>& dom, int ncosts, double density, const string& params) {
+        vector<int> rscope(dom.size());
+        for (int i = 0; i < dom.size(); ++i) rscope[i] = dom.size() - 1 - i;
+        Function f = random_function(rscope, dom, ncosts, density, ncosts + 1);
+        report_tuples("sortScope", params, f.numTuples(), time_ns([&] { f.sortScope(); }));
+    }
+
+    // base model of f alone, compact() of the levels c1 and c2, and an
+    // at-most-one over as many literals as tuples (up to 2000)
+    void bench_encoding(const Function& f, const vector<int>& dom, const vector<Cost>& c1,
+                        const vector<Cost>& c2, const string& params) {
+        Wcsp w = single_wcsp(f, dom);
+        long clauses = 0;
+        double ns = time_ns([&] {
+            CSP_sat csp(w);
+            clauses = EncodingBench::clauses(csp);
+        });
+        report_clauses("build_base_model", params, clauses, ns);
+
+        CSP_sat csp(w);
+        int n = std::min<long>(f.numTuples(), 2000);
+        bool sizes = not acc_clauses;   // aggregated results are grouped by params only
+        ns = time_ns([&] { clauses = EncodingBench::compact(csp, c1, c2); });
+        report_clauses("compact", params + (sizes ? " levels " + std::to_string(c1.size()) + "x"
+                       + std::to_string(c2.size()) : ""), clauses, ns);
+        ns = time_ns([&] { clauses = EncodingBench::at_most_one(csp, n); });
+        report_clauses("at_most_one", params + (sizes ? " n " + std::to_string(n) : ""), clauses, ns);
+    }
+
+    void synthetic(const vector<int>& arities, const vector<int>& doms,
+                   const vector<int>& ncosts, const vector<double>& densities) {
+        const long MAX_TUPLES = 1 << 22;
+        for (int a : arities) for (int d : doms) for (int c : ncosts) for (double z : densities) {
+            long n = 1;
+            for (int i = 0; i < a; ++i) n *= d;
+            if (n > MAX_TUPLES) continue;
+            std::ostringstream params;
+            params << "arity " << a << " dom " << d << " costs " << c << " density " << z;
+            vector<int> scope(a), dom(a, d);
+            for (int i = 0; i < a; ++i) scope[i] = i;
+            Function f = random_function(scope, dom, c, z, c + 1);
+            bench_function(f, params.str());
+            bench_sortScope(dom, c, z, params.str());
+            vector<Cost> c1, c2;
+            for (int k = 0; k <= c; ++k) c1.push_back(k);
+            for (int k = 0; k <= c; ++k) c2.push_back(k * (c + 1));
+            bench_encoding(f, dom, c1, c2, params.str());
+        }
+    }
+
+    // table operations and encoding primitives aggregated by arity over all
+    // the functions of the instance: compact() sums the cost levels of each
+    // function with those of the next one
+    void instance(const string& fileName) {
+        Wcsp w;
+        w.read(fileName);
+        std::map<string, pair<long, double>> totals, clause_totals;
+        acc = &totals;
+        acc_clauses = &clause_totals;
+        for (int i = 0; i < w.functions.size(); ++i) {
+            const Function& f = w.functions[i];
+            string params = "arity " + std::to_string(f.arity());
+            bench_function(f, params);
+            if (w.costs[i].size() < 2) continue; // hard
+            // the same table over variables 0..arity-1 and with the top of
+            // single_wcsp(), as it expects
+            vector<int> scope(f.arity()), dom(f.arity());
+            for (int k = 0; k < f.arity(); ++k) {
+                scope[k] = k;
+                dom[k] = w.domsize[f.getScope()[k]];
+            }
+            Function g(scope, dom, 0, SINGLE_UB);
+            for (int t : f.costlyTuples()) {
+                Cost c = f.getCost(t);
+                g.addCost(g.getTuple(t), c >= f.getTop() ? SINGLE_UB : c);
+            }
+            bench_encoding(g, dom, w.costs[i], w.costs[(i + 1) % w.costs.size()], params);
+        }
+        acc = nullptr;
+        acc_clauses = nullptr;
+        for (const auto& t : totals) {
+            size_t tab = t.first.find('\t');
+            report_tuples(t.first.substr(0, tab), t.first.substr(tab + 1),
+                          t.second.first, t.second.second);
+        }
+        for (const auto& t : clause_totals) {
+            size_t tab = t.first.find('\t');
+            report_clauses(t.first.substr(0, tab), t.first.substr(tab + 1),
+                           t.second.first, t.second.second);
+        }
+        long clauses = 0;
+        double ns = time_ns([&] {
+            CSP_sat csp(w);
+            clauses = EncodingBench::clauses(csp);
+        });
+        report_clauses("build_base_model", fileName, clauses, ns);
+    }
+};
+
+vector<double> parse_list(const char* s) {
+    vector<double> l;
+    std::stringstream ss(s);
+    string item;
+    while (std::getline(ss, item, ',')) l.push_back(atof(item.c_str()));
+    return l;
+}
+
+vector<int> to_int(const vector<double>& l) { return vector<int>(l.begin(), l.end()); }
+
+int main(int argc, char const *argv[]) {
+    vector<int> arities = {1, 2, 3, 4};
+    vector<int> doms = {2, 5, 10};
+    vector<int> ncosts = {4};
+    vector<double> densities = {0.5};
+    string fileName;
+    int reps = 3, seed = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-a") == 0) arities = to_int(parse_list(argv[i + 1]));
+        else if (strcmp(argv[i], "-d") == 0) doms = to_int(parse_list(argv[i + 1]));
+        else if (strcmp(argv[i], "-c") == 0) ncosts = to_int(parse_list(argv[i + 1]));
+        else if (strcmp(argv[i], "-z") == 0) densities = parse_list(argv[i + 1]);
+        else if (strcmp(argv[i], "-r") == 0) reps = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-seed") == 0) seed = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-f") == 0) fileName = argv[i + 1];
+    }
+
+    MicroBench bench(seed);
+    bench.reps = reps;
+    if (fileName.size() > 0) bench.instance(fileName);
+    else bench.synthetic(arities, doms, ncosts, densities);
+}
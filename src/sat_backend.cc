@@ -0,0 +1,65 @@
+#include <cstdlib>
+#include <dlfcn.h>
+#include <iostream>
+#include <sstream>
+
+#include "sat_backend.hh"
+
+using namespace std;
+
+SatBackend* SatBackend::create(const string& spec) {
+    string kind = spec.substr(0, spec.find(':'));
+    string arg = spec.find(':') == string::npos ? "" : spec.substr(spec.find(':') + 1);
+    if (kind == "cadical") return new CadicalBackend(arg);
+    if (kind == "ipasir") return new IpasirBackend(arg);
+    cerr << "Error: unknown sat backend " << spec << endl;
+    exit(EXIT_FAILURE);
+}
+
+CadicalBackend::CadicalBackend(const string& options) {
+    stringstream ss(options);
+    string option;
+    while (getline(ss, option, ',')) {
+        size_t eq = option.find('=');
+        if (eq == string::npos or not solver.set(option.substr(0, eq).c_str(), atoi(option.substr(eq + 1).c_str()))) {
+            cerr << "Error: wrong CaDiCaL option " << option << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    solver.connect_terminator(&terminator);
+}
+
+IpasirBackend::IpasirBackend(const string& file) {
+    library = dlopen(file.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (not library) {
+        cerr << "Error: " << dlerror() << endl;
+        exit(EXIT_FAILURE);
+    }
+    auto symbol = [&](const char* name) {
+        void* s = dlsym(library, name);
+        if (not s) {
+            cerr << "Error: " << file << " has no " << name << endl;
+            exit(EXIT_FAILURE);
+        }
+        return s;
+    };
+    const char* (*ipasir_signature)() = (const char* (*)()) symbol("ipasir_signature");
+    void* (*ipasir_init)() = (void* (*)()) symbol("ipasir_init");
+    void (*ipasir_set_terminate)(void*, void*, int (*)(void*)) =
+        (void (*)(void*, void*, int (*)(void*))) symbol("ipasir_set_terminate");
+    ipasir_add = (void (*)(void*, int)) symbol("ipasir_add");
+    ipasir_assume = (void (*)(void*, int)) symbol("ipasir_assume");
+    ipasir_solve = (int (*)(void*)) symbol("ipasir_solve");
+    ipasir_val = (int (*)(void*, int)) symbol("ipasir_val");
+    ipasir_failed = (int (*)(void*, int)) symbol("ipasir_failed");
+    ipasir_release = (void (*)(void*)) symbol("ipasir_release");
+
+    signature = ipasir_signature();
+    solver = ipasir_init();
+    ipasir_set_terminate(solver, nullptr, expired);
+}
+
+IpasirBackend::~IpasirBackend() {
+    ipasir_release(solver);
+    dlclose(library);
+}
@@ -0,0 +1,90 @@
+#ifndef SAT_BACKEND_HH
+#define SAT_BACKEND_HH
+
+#include <string>
+#include "sat-cadical/src/cadical.hpp"
+#include "budget.hh"
+
+using std::string;
+
+///incremental sat solver used by CSP_sat, with the semantics of IPASIR:
+///a clause ends with literal 0, assumptions hold for the next solve() only,
+///and val() / failed() refer to the last solve()
+class SatBackend {
+public:
+    static const int SAT = 10, UNSAT = 20, UNKNOWN = 0;
+
+    virtual ~SatBackend() {}
+    virtual string name() const = 0;
+    virtual void add(int lit) = 0;
+    virtual void assume(int lit) = 0;
+    // UNKNOWN if the budget of the run expires (or a limit is reached)
+    virtual int solve() = 0;
+    // lit if it is true in the model of the last SAT solve, else -lit
+    virtual int val(int lit) = 0;
+    // the assumption lit is in the final conflict of the last UNSAT solve
+    virtual bool failed(int lit) = 0;
+    // conflicts/decisions limit of the next solve (ignored if not supported)
+    virtual void limit(const char* name, int n) {}
+    // the decisions on the variable of lit pick lit first (ignored if not supported)
+    virtual void phase(int lit) {}
+    // clauses held by the solver
+    virtual long clauses() const = 0;
+
+    // spec: "cadical", "cadical:option=value,..." or "ipasir:library.so"
+    static SatBackend* create(const string& spec);
+};
+
+// stops CaDiCaL when the budget of the run is exhausted
+class BudgetTerminator : public CaDiCaL::Terminator {
+public:
+    bool terminate() { return Budget::expired(); }
+};
+
+class CadicalBackend : public SatBackend {
+public:
+    CadicalBackend(const string& options); // "option=value,..." set before any clause
+    string name() const { return "cadical"; }
+    void add(int lit) { solver.add(lit); }
+    void assume(int lit) { solver.assume(lit); }
+    int solve() { return solver.solve(); }
+    int val(int lit) { return solver.val(lit); }
+    bool failed(int lit) { return solver.failed(lit); }
+    void limit(const char* name, int n) { solver.limit(name, n); }
+    void phase(int lit) { solver.phase(lit); }
+    long clauses() const { return solver.irredundant(); }
+
+private:
+    BudgetTerminator terminator;
+    CaDiCaL::Solver solver;
+};
+
+// any solver implementing the IPASIR interface, loaded from a shared library
+class IpasirBackend : public SatBackend {
+public:
+    IpasirBackend(const string& library);
+    ~IpasirBackend();
+    string name() const { return signature; }
+    void add(int lit) { ipasir_add(solver, lit); if (lit == 0) ++nclauses; }
+    void assume(int lit) { ipasir_assume(solver, lit); }
+    int solve() { return ipasir_solve(solver); }
+    int val(int lit) { return ipasir_val(solver, lit) > 0 ? lit : -lit; }
+    bool failed(int lit) { return ipasir_failed(solver, lit) != 0; }
+    long clauses() const { return nclauses; } // clauses added (IPASIR has no count)
+
+private:
+    void* library;
+    void* solver;
+    string signature;
+    long nclauses = 0;
+    void (*ipasir_add)(void*, int);
+    void (*ipasir_assume)(void*, int);
+    int (*ipasir_solve)(void*);
+    int (*ipasir_val)(void*, int);
+    int (*ipasir_failed)(void*, int);
+    void (*ipasir_release)(void*);
+
+    static int expired(void*) { return Budget::expired(); }
+};
+
+#endif
@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <iostream>
+#include "td.hh"
+#include "budget.hh"
+
+using std::cout;
+using std::endl;
+
+TreeDecomposition::TreeDecomposition(const Wcsp& wcsp) : wcsp(wcsp), adj(wcsp.nvars) {
+    for (const Function& f : wcsp.functions) {
+        const vector<int>& scope = f.getScope();
+        for (int x : scope) for (int y : scope)
+            if (x != y) adj[x].insert(y);
+    }
+}
+
+// edges to add among the neighbours of v when it is eliminated
+int TreeDecomposition::fill(const vector<set<int>>& g, int v) const {
+    int n = 0;
+    for (auto i = g[v].begin(); i != g[v].end(); ++i) {
+        auto j = i;
+        for (++j; j != g[v].end(); ++j)
+            if (g[*i].count(*j) == 0) ++n;
+    }
+    return n;
+}
+
+void TreeDecomposition::decompose(TdHeuristic h, double timeLimit) {
+    auto start = steady_clock::now();
+    int n = wcsp.nvars;
+    vector<set<int>> g = adj;
+    vector<bool> eliminated(n, false);
+    vector<int> pos(n);
+    order.clear();
+    bags.assign(n, {});
+    treewidth = 0;
+
+    // scores are recomputed only around the eliminated variables
+    vector<int> score(n);
+    for (int v = 0; v < n; ++v) score[v] = h == TD_MIN_FILL ? fill(g, v) : g[v].size();
+
+    for (int step = 0; step < n; ++step) {
+        if (h == TD_MIN_FILL and (Budget::expired() or
+            duration_cast<duration<double>>(steady_clock::now() - start).count() > timeLimit)) {
+            cout << "td: min-fill stopped after " << step << " variables, min-degree for the rest" << endl;
+            h = TD_MIN_DEGREE;
+            for (int v = 0; v < n; ++v) score[v] = g[v].size();
+        }
+        // ties broken by degree and then by the lower variable
+        int v = -1;
+        for (int u = 0; u < n; ++u) if (not eliminated[u]) {
+            if (v == -1 or score[u] < score[v] or (score[u] == score[v] and g[u].size() < g[v].size()))
+                v = u;
+        }
+        eliminated[v] = true;
+        pos[v] = order.size();
+        order.push_back(v);
+        bags[v].push_back(v);
+        bags[v].insert(bags[v].end(), g[v].begin(), g[v].end());
+        treewidth = std::max(treewidth, (int) g[v].size());
+        for (int x : g[v]) {
+            g[x].erase(v);
+            for (int y : g[v]) if (x != y) g[x].insert(y);
+        }
+        set<int> touched;
+        for (int x : bags[v]) if (x != v) {
+            touched.insert(x);
+            if (h == TD_MIN_FILL) touched.insert(g[x].begin(), g[x].end());
+        }
+        for (int x : touched) score[x] = h == TD_MIN_FILL ? fill(g, x) : g[x].size();
+        g[v].clear();
+    }
+
+    parent.assign(n, -1);
+    for (int v : order)
+        for (int x : bags[v])
+            if (x != v and (parent[v] == -1 or pos[x] < pos[parent[v]])) parent[v] = x;
+}
+
+vector<vector<int>> TreeDecomposition::clusters() const {
+    int n = wcsp.nvars;
+    vector<int> pos(n);
+    for (int i = 0; i < order.size(); ++i) pos[order[i]] = i;
+
+    // rep[v]: maximal bag that contains the bag of v
+    vector<int> rep(n);
+    for (int v = 0; v < n; ++v) rep[v] = v;
+    vector<vector<int>> sorted(n);
+    for (int v = 0; v < n; ++v) {
+        sorted[v] = bags[v];
+        std::sort(sorted[v].begin(), sorted[v].end());
+    }
+    vector<bool> absorbed(n, false);
+    for (int v : order) {
+        int p = parent[v];
+        if (p == -1 or absorbed[p]) continue;
+        const vector<int>& bv = sorted[rep[v]];
+        const vector<int>& bp = sorted[p];
+        if (std::includes(bv.begin(), bv.end(), bp.begin(), bp.end())) { // parent bag not maximal
+            rep[p] = rep[v];
+            absorbed[p] = true;
+        }
+    }
+
+    vector<vector<int>> byBag(n);
+    vector<int> nullary;
+    for (int i = 0; i < wcsp.nfuncs; ++i) {
+        if (wcsp.costs[i].size() <= 1) continue;  // hard
+        const vector<int>& scope = wcsp.functions[i].getScope();
+        if (scope.empty()) { nullary.push_back(i); continue; }
+        int first = scope[0];
+        for (int x : scope) if (pos[x] < pos[first]) first = x;
+        byBag[rep[first]].push_back(i);
+    }
+
+    vector<vector<int>> part;
+    for (int v : order)
+        if (byBag[v].size() > 0) part.push_back(byBag[v]);
+    if (nullary.size() > 0) part.push_back(nullary);
+    return part;
+}
@@ -0,0 +1,46 @@
+#ifndef TD_HH
+#define TD_HH
+
+#include <set>
+#include <string>
+#include <vector>
+#include "wcsp.hh"
+
+using std::set;
+using std::string;
+using std::vector;
+
+typedef enum {
+    TD_MIN_FILL,
+    TD_MIN_DEGREE
+} TdHeuristic;
+
+// Tree decomposition of the primal graph of a wcsp by variable elimination.
+// Each function goes to the bag of the first eliminated variable of its scope;
+// bags contained in a neighbour are merged, so the clusters are the functions
+// of the maximal bags in leaves-to-root order (as the .td.l2r files).
+class TreeDecomposition {
+public:
+    TreeDecomposition(const Wcsp& wcsp);
+
+    // Post: elimination order, bags and parents computed. Min-fill switches
+    //       to min-degree for the remaining variables after timeLimit seconds
+    void decompose(TdHeuristic h, double timeLimit);
+    // Post: soft functions of each maximal bag (empty clusters skipped)
+    vector<vector<int>> clusters() const;
+    int width() const { return treewidth; }
+    // Post: variables from the root to the leaves (reverse elimination order)
+    vector<int> root_order() const { return vector<int>(order.rbegin(), order.rend()); }
+
+private:
+    const Wcsp& wcsp;
+    vector<set<int>> adj;           // primal graph
+    vector<int> order;              // elimination order
+    vector<vector<int>> bags;       // bag of each variable: itself and its neighbours when eliminated
+    vector<int> parent;             // first eliminated neighbour (-1 for roots)
+    int treewidth = -1;
+
+    int fill(const vector<set<int>>& g, int v) const;
+};
+
+#endif
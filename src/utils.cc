@@ -4,6 +4,8 @@
 #include <vector>
 #include <string>
 #include <iostream>
+#include <fstream>
+#include <cstdint>
 
 using std::vector;
 using std::ostream;
@@ -37,9 +39,9 @@ ostream &operator<<(ostream &os, const vector<vector<T>> &v) {
 
 template <typename T>
 bool operator==(const vector<T> &v1, const vector<T> &v2) {
-    assert(v1.size() == v2.size());
+    if (v1.size() != v2.size()) return false;
     for (int i = 0; i < v1.size(); ++i)
-        if (not v1[i] == v2[i]) return false;
+        if (not (v1[i] == v2[i])) return false;
     return true;
 }
 
@@ -96,4 +98,29 @@ vector<T> operator-(const vector<T>& v, T x) {
     return r;
 }
 
+// binary files (encoding cache, checkpoints): size and elements of v
+template <typename T>
+void write_vector(std::ofstream& out, const vector<T>& v) {
+    uint64_t n = v.size();
+    out.write((const char*) &n, sizeof(n));
+    if (n > 0) out.write((const char*) v.data(), n * sizeof(T));
+}
+
+// fails (without allocating) if the length exceeds what is left in the file
+template <typename T>
+bool read_vector(std::ifstream& in, vector<T>& v) {
+    uint64_t n = 0;
+    if (not in.read((char*) &n, sizeof(n))) return false;
+    std::streampos pos = in.tellg();
+    in.seekg(0, std::ios::end);
+    uint64_t left = in.tellg() - pos;
+    in.seekg(pos);
+    if (n > left / sizeof(T)) {
+        in.setstate(std::ios::failbit);
+        return false;
+    }
+    v.resize(n);
+    return n == 0 or bool(in.read((char*) v.data(), n * sizeof(T)));
+}
+
 #endif
@@ -3,6 +3,7 @@
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "function.hh"
@@ -13,12 +14,13 @@ using std::endl;
 using std::string;
 using std::vector;
 
-Wcsp::Wcsp() : nvars(0), nfuncs(0), lb(0), ub(0) {}
+Wcsp::Wcsp() : nvars(0), nfuncs(0), lb(0), ub(0), top(0) {}
 
 void Wcsp::create_case_study(int n, int type) {
     nvars = n;
     lb = 0;
     ub = n*n + 1;
+    top = ub;
     domsize = vector<int>(nvars, n);
     functions.reserve(nvars);   // nvars unarias
     nfuncs = n;
@@ -35,6 +37,8 @@ void Wcsp::create_case_study(int n, int type) {
     }
     alldiff = type == 0;
     greaterthan = type == 1;
+    varOrd = vector<int>(nvars);
+    for (int i = 0; i < nvars; ++i) varOrd[i] = i;
 }
 
 vector<vector<int>> Wcsp::partition_abstract_core(const vector<vector<int>>& partitions) {
@@ -48,15 +52,17 @@ vector<vector<int>> Wcsp::partition_abstract_core(const vector<vector<int>>& par
             else {  // soft
                 costs_cl.insert(costs[id_f].begin(), costs[id_f].end());
                 dict[costs[id_f][1]].push_back(id_f);
-                for (int i = 2; i < costs[id_f].size(); ++i) {
-                    Cost c = costs[id_f][i];
-                    Function f_aux = functions[id_f].split(c);
+                // one sparse function per cost but the first one, in a single pass
+                vector<Cost> cs(costs[id_f].begin() + 2, costs[id_f].end());
+                vector<Function> f_split = functions[id_f].split(cs);
+                for (int i = 0; i < cs.size(); ++i) {
+                    Cost c = cs[i];
                     int id_f_aux = functions.size();
-                    functions.push_back(f_aux);
+                    functions.push_back(f_split[i]);
                     costs.push_back({0, c});
                     assert(functions.size() == costs.size());
                     //actualizar var2functions
-                    const vector<int>& scope = f_aux.getScope();
+                    const vector<int>& scope = f_split[i].getScope();
                     for (int var : scope) var2functions[var].push_back(id_f_aux);
 
                     dict[c].push_back(id_f_aux);
@@ -116,7 +122,9 @@ void Wcsp::sortVariables(int option) {
     varOrd[i] = v[nvars - 1 - i].second; //v[i].second;
 }
 
-void Wcsp::read(string fileName) {
+// if shrink, every table is shrunk as soon as it is read, so only the one
+// being parsed is dense
+void Wcsp::read(string fileName, bool shrink) {
   fstream file(fileName);
   if (not file.is_open()) {
     cerr << "Error: File " << fileName << "cannot be opened" << endl;
@@ -132,6 +140,7 @@ void Wcsp::read(string fileName) {
   bool consistent = true; // there must be a zero cost in every cost function
   int unsorted = 0;
   var2functions = vector<vector<int>>(nvars);
+  functions.reserve(nfuncs);
   for (int i = 0; i < nfuncs; ++i) {
     int arity;
     file >> arity;
@@ -171,12 +180,12 @@ void Wcsp::read(string fileName) {
             consistent = false;
             lb2 = lb2 + mincost;
           }
-          if (f.sortedScope()) functions.push_back(f);
+          if (f.sortedScope()) functions.push_back(std::move(f));
           else {
             unsorted++;
-            Function f2 = f.sortScope();
-            functions.push_back(f2);
+            functions.push_back(f.sortScope());
           }
+          if (shrink) functions.back().shrink();
       }
       else {
           // global constraint ... not considered here
@@ -199,6 +208,7 @@ void Wcsp::read(string fileName) {
   lb = lb + lb2;
   assert(lb < ub);
   ub = ub - lb;
+  top = ub;
   cout << "lb " << 0 << " ub " << ub << " after adjustment" << endl;
   if (lb > 0)
     for (int i = 0; i < functions.size(); i++)
@@ -209,6 +219,15 @@ void Wcsp::read(string fileName) {
   for (int i = 0; i < nvars; i++)
     varOrd[i] = i;
 
+  funcMap = vector<int>(functions.size());
+  for (int i = 0; i < functions.size(); i++)
+    funcMap[i] = i;
+
+  update_costs();
+}
+
+// cost vectors of the functions and 2nd adjustment of ub
+void Wcsp::update_costs() {
   // create cost vectors
   costs = vector<vector<Cost>>(functions.size());
   for (int i = 0; i < functions.size(); ++i)
@@ -231,6 +250,369 @@ void Wcsp::read(string fileName) {
   }
 }
 
+// Post: variables whose incident functions join into at most max_tuples tuples
+//       are eliminated (fewest neighbours first, then smallest join): the join
+//       of their functions is replaced by its projection and kept for
+//       reconstruct(). Returns the number of variables eliminated
+int Wcsp::eliminate(long max_tuples) {
+  assert(not alldiff and not greaterthan);
+  vector<bool> alive(functions.size(), true);
+  Cost shift = 0; // minimum costs of the projections (to lb)
+  while (true) {
+    int best = -1;
+    long best_tuples = 0;
+    int best_degree = 0;
+    for (int x = 0; x < nvars; x++) {
+      if (var2functions[x].empty()) continue;
+      set<int> vars;
+      for (int f : var2functions[x]) {
+        vector<int> scope = functions[f].getScope();
+        vars.insert(scope.begin(), scope.end());
+      }
+      long tuples = 1;
+      for (int y : vars) {
+        tuples *= domsize[y];
+        if (tuples > max_tuples) break;
+      }
+      int degree = vars.size() - 1;
+      if (tuples <= max_tuples and (best == -1 or degree < best_degree or
+          (degree == best_degree and tuples < best_tuples))) {
+        best = x;
+        best_tuples = tuples;
+        best_degree = degree;
+      }
+    }
+    if (best == -1) break;
+
+    int x = best;
+    vector<int> incident = var2functions[x];
+    Function joined = functions[incident[0]];
+    for (int i = 1; i < incident.size(); i++)
+      joined = joined.join(functions[incident[i]]);
+    eliminated.push_back(make_pair(x, joined));
+
+    for (int f : incident) {
+      alive[f] = false;
+      for (int y : functions[f].getScope()) {
+        vector<int>& fs = var2functions[y];
+        fs.erase(find(fs.begin(), fs.end(), f));
+      }
+    }
+    int id_g = -1;  // projection on a constant: to lb
+    if (joined.arity() == 1) shift += joined.getMinCost();
+    else {
+      Function g = joined.project(x);
+      Cost c = g.getMinCost();
+      if (c > 0) {
+        g.substractCost(c);
+        shift += c;
+      }
+      id_g = functions.size();
+      functions.push_back(g);
+      alive.push_back(true);
+      for (int y : g.getScope()) var2functions[y].push_back(id_g);
+    }
+    for (int i = 0; i < funcMap.size(); i++)
+      if (funcMap[i] != -1 and not alive[funcMap[i]]) funcMap[i] = id_g;
+  }
+
+  remove_functions(alive);
+  shift_lb(shift);
+  update_costs();
+  cout << eliminated.size() << " variables eliminated, " << nfuncs << " functions, lb "
+       << lb << " ub " << ub << " after elimination" << endl;
+  return eliminated.size();
+}
+
+// Post: every table in its smallest form (see Function::shrink). Returns
+//       the bytes of the tables
+long Wcsp::shrink_tables() {
+  long bytes = 0;
+  for (Function& f : functions) {
+    f.shrink();
+    bytes += f.bytes();
+  }
+  return bytes;
+}
+
+// Post: the functions not alive are removed (funcMap and var2functions renumbered)
+void Wcsp::remove_functions(const vector<bool>& alive) {
+  vector<int> newId(functions.size(), -1);
+  vector<Function> kept;
+  for (int f = 0; f < functions.size(); f++) if (alive[f]) {
+    newId[f] = kept.size();
+    kept.push_back(functions[f]);
+  }
+  functions.swap(kept);
+  nfuncs = functions.size();
+  for (int i = 0; i < funcMap.size(); i++)
+    if (funcMap[i] != -1) funcMap[i] = newId[funcMap[i]];
+  var2functions = vector<vector<int>>(nvars);
+  for (int f = 0; f < nfuncs; f++)
+    for (int y : functions[f].getScope()) var2functions[y].push_back(f);
+}
+
+struct ScopeHash {
+  size_t operator()(const vector<int>& scope) const {
+    size_t h = 14695981039346656037ULL;  // FNV-1a
+    for (int x : scope) h = (h ^ (size_t) x) * 1099511628211ULL;
+    return h;
+  }
+};
+
+// Post: functions with the same scope are summed and functions whose scope
+//       is included in the scope of another one are joined into it (the
+//       smallest such superset). Sparse tables are left apart, since the
+//       join is dense. Minimum costs of the sums go to lb. Returns the number
+//       of functions merged
+int Wcsp::merge_scopes() {
+  assert(not alldiff and not greaterthan);
+  vector<bool> alive(functions.size(), true);
+  vector<int> into(functions.size(), -1);   // function that absorbed f
+  int merged = 0;
+
+  // same scope: hashed on the (sorted) scope
+  unordered_map<vector<int>, int, ScopeHash> byScope;
+  for (int f = 0; f < functions.size(); f++) {
+    if (functions[f].arity() == 0 or functions[f].isSparse()) continue;
+    auto it = byScope.find(functions[f].getScope());
+    if (it == byScope.end()) byScope[functions[f].getScope()] = f;
+    else {
+      functions[it->second] = functions[it->second].join(functions[f]);
+      alive[f] = false;
+      into[f] = it->second;
+      merged++;
+    }
+  }
+
+  // nested scopes: smaller arities first, so chains end in the largest scope
+  vector<int> order;
+  for (int f = 0; f < functions.size(); f++)
+    if (alive[f] and functions[f].arity() > 0 and not functions[f].isSparse()) order.push_back(f);
+  stable_sort(order.begin(), order.end(),
+              [&](int f, int g) { return functions[f].arity() < functions[g].arity(); });
+  for (int f : order) {
+    const vector<int>& scope = functions[f].getScope();
+    int best = -1;
+    for (int g : var2functions[scope[0]]) {
+      if (not alive[g] or g == f or functions[g].arity() <= functions[f].arity() or functions[g].isSparse())
+        continue;
+      const vector<int>& sg = functions[g].getScope();
+      if (includes(sg.begin(), sg.end(), scope.begin(), scope.end()) and
+          (best == -1 or functions[g].numTuples() < functions[best].numTuples()))
+        best = g;
+    }
+    if (best == -1) continue;
+    functions[best] = functions[best].join(functions[f]);
+    alive[f] = false;
+    into[f] = best;
+    merged++;
+  }
+
+  Cost shift = 0; // a sum may have no tuple of cost 0
+  for (int f = 0; f < functions.size(); f++) {
+    if (not alive[f]) continue;
+    Cost c = functions[f].getMinCost();
+    if (c > 0) {
+      functions[f].substractCost(c);
+      shift += c;
+    }
+  }
+  for (int i = 0; i < funcMap.size(); i++) {
+    int f = funcMap[i];
+    while (f != -1 and not alive[f]) f = into[f];
+    funcMap[i] = f;
+  }
+  remove_functions(alive);
+  shift_lb(shift);
+  update_costs();
+  cout << merged << " functions merged into functions with the same or a larger scope, "
+       << nfuncs << " functions" << endl;
+  return merged;
+}
+
+// Post: the costs of the tuples of deltas are changed and the cost levels of
+//       their functions updated. Pre: no preprocessing (functions as read),
+//       costs stay in [0, top) and hard tuples do not change. ub is raised
+//       with the maximum costs (2nd adjustment again) up to top, never lowered
+void Wcsp::apply(const vector<CostDelta>& deltas) {
+  if (not eliminated.empty() or funcMap.size() != functions.size()) {
+    cout << "Error: cost updates need the functions as read (no preprocessing)" << endl;
+    exit(0);
+  }
+  // the costs move under the top of the instance, ub is set again below
+  Cost old_ub = ub;
+  ub = top;
+  for (int i = 0; i < nfuncs; i++) functions[i].raiseTop(ub);
+  vector<bool> changed(nfuncs, false);
+  for (const CostDelta& d : deltas) {
+    if (d.func < 0 or d.func >= nfuncs or funcMap[d.func] != d.func or
+        d.tuple.size() != functions[d.func].arity()) {
+      cout << "Error: invalid cost update of function " << d.func << endl;
+      exit(0);
+    }
+    Function& f = functions[d.func];
+    for (int i = 0; i < d.tuple.size(); i++)
+      if (d.tuple[i] < 0 or d.tuple[i] >= domsize[f.getScope()[i]]) {
+        cout << "Error: invalid tuple in a cost update of function " << d.func << endl;
+        exit(0);
+      }
+    Cost c = f.getCost(d.tuple);
+    if (c >= ub or c + d.delta < 0 or c + d.delta >= ub) {
+      cout << "Error: cost update of function " << d.func << " out of [0, top) or on a hard tuple" << endl;
+      exit(0);
+    }
+    f.addCost(d.tuple, c + d.delta);
+    changed[d.func] = true;
+  }
+  Cost max_sum = 0;
+  for (int i = 0; i < nfuncs; i++) {
+    if (changed[i]) {
+      costs[i] = functions[i].allCosts();
+      if (costs[i].empty() or costs[i][0] != 0) costs[i].insert(costs[i].begin(), 0);  // level 0 is always 0
+    }
+    if (not costs[i].empty()) max_sum += costs[i].back();
+  }
+  // sums >= top are forbidden, as in the instance read; lowering ub would
+  // make the sums the solver allows reach it
+  ub = min(top, max(old_ub, max_sum + 1));
+  for (int i = 0; i < nfuncs; i++) functions[i].updateTop(ub);
+  if (ub > old_ub) cout << "ub " << ub << " after the cost updates" << endl;
+}
+
+// Post: shift moved to lb, ub and the tops of the functions decreased
+void Wcsp::shift_lb(Cost shift) {
+  if (shift >= ub) {
+    cout << "Error: the lb reaches the ub (no solution)" << endl;
+    exit(0);
+  }
+  lb = lb + shift;
+  ub = ub - shift;
+  top = top - shift;
+  if (shift > 0)
+    for (int i = 0; i < functions.size(); i++)
+      functions[i].updateTop(ub);
+}
+
+// Post: AC* (GAC* on non-binary functions): the minimum cost of every value
+//       in each function is projected to the unary function of the variable
+//       (created if missing), the minimum of each unary function to lb, and
+//       values whose unary cost reaches ub are forbidden. Up to max_passes
+//       passes, until no cost moves. Returns the lb increase
+Cost Wcsp::soft_ac(int max_passes) {
+  assert(not alldiff and not greaterthan);
+  Cost shift = 0;
+  vector<int> unary(nvars, -1);
+  for (int f = 0; f < functions.size(); f++)
+    if (functions[f].arity() == 1 and unary[functions[f].getScope()[0]] == -1)
+      unary[functions[f].getScope()[0]] = f;
+  int nunary = 0;
+
+  bool changed = true;
+  int pass = 0;
+  for (; changed and pass < max_passes; pass++) {
+    changed = false;
+    for (int f = 0; f < functions.size(); f++) {
+      if (functions[f].arity() < 2) continue;
+      for (int x : functions[f].getScope()) {
+        vector<Cost> m = functions[f].minCosts(x);
+        bool some = false;
+        for (int a = 0; a < domsize[x]; a++) {
+          if (m[a] >= functions[f].getTop() and unary[x] != -1 and functions[unary[x]].getCost({a}) >= ub)
+            m[a] = 0;   // already forbidden
+          some = some or m[a] > 0;
+        }
+        if (not some) continue;
+        changed = true;
+        if (unary[x] == -1) {
+          unary[x] = functions.size();
+          functions.push_back(Function({x}, {domsize[x]}, 0, ub));
+          var2functions[x].push_back(unary[x]);
+          nunary++;
+        }
+        functions[f].substractCosts(x, m);
+        Function& u = functions[unary[x]];
+        for (int a = 0; a < domsize[x]; a++)
+          u.addCost({a}, min(u.getCost({a}) + m[a], ub));
+      }
+    }
+    for (int x = 0; x < nvars; x++) {
+      if (unary[x] == -1) continue;
+      Function& u = functions[unary[x]];
+      Cost c = u.getMinCost();
+      if (c > 0 and c < ub) {
+        u.substractCost(c);
+        shift += c;
+        changed = true;
+      }
+      for (int a = 0; a < domsize[x]; a++)   // NC*: lb + u(a) >= ub
+        if (u.getCost({a}) < ub and u.getCost({a}) + shift >= ub) {
+          u.addCost({a}, ub);
+          changed = true;
+        }
+    }
+  }
+  nfuncs = functions.size();
+  shift_lb(shift);
+  update_costs();
+  cout << "soft arc consistency: " << pass << " passes, " << nunary << " unary functions added, lb "
+       << lb << " ub " << ub << endl;
+  return shift;
+}
+
+// values of the eliminated variables (in reverse order) minimizing the
+// joined functions given the rest of the assignment
+vector<int> Wcsp::reconstruct(vector<int> assign) const {
+  for (int i = eliminated.size() - 1; i >= 0; i--) {
+    int x = eliminated[i].first;
+    const Function& f = eliminated[i].second;
+    int best_val = 0;
+    Cost best_cost = -1;
+    for (int a = 0; a < domsize[x]; a++) {
+      assign[x] = a;
+      Cost c = f.getCostAssg(assign);
+      if (best_cost == -1 or c < best_cost) {
+        best_cost = c;
+        best_val = a;
+      }
+    }
+    assign[x] = best_val;
+  }
+  return assign;
+}
+
+// writes the instance in .wcsp format: lb as a nullary function and
+// costs >= ub (hard) as the original ub
+void Wcsp::write(string fileName) const {
+  ofstream file(fileName);
+  if (not file.is_open()) {
+    cerr << "Error: File " << fileName << " cannot be opened" << endl;
+    exit(EXIT_FAILURE);
+  }
+  int maxdomsize = 0;
+  for (int d : domsize) maxdomsize = max(maxdomsize, d);
+  file << "wcsp " << nvars << " " << maxdomsize << " "
+       << functions.size() + (lb > 0) << " " << lb + ub << endl;
+  for (int i = 0; i < nvars; ++i) file << (i > 0 ? " " : "") << domsize[i];
+  file << endl;
+  if (lb > 0) file << "0 " << lb << " 0" << endl;
+  for (const Function& f : functions) {
+    vector<int> scope = f.getScope();
+    int ntuples = 0;
+    for (int t = 0; t < f.numTuples(); ++t) if (f.getCost(t) > 0) ++ntuples;
+    file << scope.size();
+    for (int x : scope) file << " " << x;
+    file << " 0 " << ntuples << endl;
+    for (int t = 0; t < f.numTuples(); ++t) {
+      Cost c = f.getCost(t);
+      if (c == 0) continue;
+      vector<int> tuple = f.getTuple(t);
+      for (int a : tuple) file << a << " ";
+      file << (c >= ub ? lb + ub : c) << endl;
+    }
+  }
+}
+
 void Wcsp::show(int level) const {
   cout << nvars << " variables ";
   cout << nfuncs << " functions " << lb << " lb, " << ub << " ub" << endl;
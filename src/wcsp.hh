@@ -8,6 +8,12 @@
 using std::string;
 using std::vector;
 
+// edit of an instance: cost of tuple of function func += delta
+struct CostDelta {
+  int func;
+  vector<int> tuple;  // values of the scope of func
+  Cost delta;
+};
 
 class Wcsp {
 public:
@@ -15,6 +21,7 @@ public:
   int nfuncs;
   Cost lb;
   Cost ub;
+  Cost top;                   // costs >= top are hard in the instance as read (ub before the 2nd adjustment)
   vector<int> domsize;
   vector<Function> functions; // explicit in tables
 
@@ -27,6 +34,8 @@ public:
 
   vector<vector<Cost>> costs; // functions costs
   vector<int> varOrd;         // variable ordering
+  vector<int> funcMap;        // function of the file -> current function (-1: absorbed in lb)
+  vector<pair<int, Function>> eliminated; // variable eliminated, join of its functions
 
 
 public:
@@ -42,7 +51,17 @@ public:
   // computes funcs's idx-th cost (last cost is ub)
   Cost index2cost(int func, int idx) const;
   void sortVariables(int option = 0);
-  void read(string fileName);
+  void read(string fileName, bool shrink = false);
+  void update_costs();
+  long shrink_tables();
+  int merge_scopes();
+  int eliminate(long max_tuples);
+  Cost soft_ac(int max_passes);
+  void shift_lb(Cost shift);
+  void remove_functions(const vector<bool>& alive);
+  vector<int> reconstruct(vector<int> assign) const;
+  void apply(const vector<CostDelta>& deltas);
+  void write(string fileName) const;
   void show(int level) const;
   Cost costAssign(const vector<int>& assign) const;
 };
@@ -0,0 +1,66 @@
+#include <cstring>
+#include <iostream>
+#include "generator.hh"
+
+void printHelp(string p) {
+    cout << "USAGE:" << endl;
+    cout << "\t" << p << " -o instance.wcsp [options]" << endl;
+    cout << "\t\t writes instance.wcsp and its cluster file instance.wcsp.td.l2r (see mhs_wcsp -p)" << endl;
+    cout << "\t\t -n int : number of variables (default 100)" << endl;
+    cout << "\t\t -d int : domain size (default 3)" << endl;
+    cout << "\t\t -k int : arity of the functions, 2 or 3 (default 2)" << endl;
+    cout << "\t\t -graph random|grid : scopes on a random hypergraph or on a grid (default random)" << endl;
+    cout << "\t\t -m int : number of functions of arity k on random graphs (default 300)" << endl;
+    cout << "\t\t -tight double : fraction of tuples with cost > 0 (default 0.3)" << endl;
+    cout << "\t\t -c int : number of distinct costs (default 5)" << endl;
+    cout << "\t\t -step int : costs are step * {1, ..., c} (default 1)" << endl;
+    cout << "\t\t -hard double : fraction of costed tuples that are forbidden (default 0)" << endl;
+    cout << "\t\t -unary double : probability of a unary function per variable (default 1)" << endl;
+    cout << "\t\t -planted : plant an optimal assignment of known cost > 0 (printed)" << endl;
+    cout << "\t\t -cluster int : variables per cluster in the cluster file (default 10)" << endl;
+    cout << "\t\t -seed int : random seed (default 0)" << endl;
+}
+
+int main(int argc, char const *argv[]) {
+    GenParams p;
+    string out;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i],"-h") == 0) {
+            printHelp(argv[0]);
+            exit(0);
+        }
+        else if (strcmp(argv[i],"-o") == 0) out = argv[i + 1];
+        else if (strcmp(argv[i],"-n") == 0) p.nvars = atoi(argv[i + 1]);
+        else if (strcmp(argv[i],"-d") == 0) p.domsize = atoi(argv[i + 1]);
+        else if (strcmp(argv[i],"-k") == 0) p.arity = atoi(argv[i + 1]);
+        else if (strcmp(argv[i],"-graph") == 0) p.graph = argv[i + 1];
+        else if (strcmp(argv[i],"-m") == 0) p.nfuncs = atoi(argv[i + 1]);
+        else if (strcmp(argv[i],"-tight") == 0) p.tightness = atof(argv[i + 1]);
+        else if (strcmp(argv[i],"-c") == 0) p.ncosts = atoi(argv[i + 1]);
+        else if (strcmp(argv[i],"-step") == 0) p.costStep = atol(argv[i + 1]);
+        else if (strcmp(argv[i],"-hard") == 0) p.hard = atof(argv[i + 1]);
+        else if (strcmp(argv[i],"-unary") == 0) p.unary = atof(argv[i + 1]);
+        else if (strcmp(argv[i],"-planted") == 0) p.planted = true;
+        else if (strcmp(argv[i],"-cluster") == 0) p.clusterSize = atoi(argv[i + 1]);
+        else if (strcmp(argv[i],"-seed") == 0) p.seed = atoi(argv[i + 1]);
+    }
+    if (out.size() == 0) {
+        cout << "Error: missing output file (-o)." << endl;
+        exit(0);
+    }
+    if (p.graph != "random" and p.graph != "grid") {
+        cout << "Error: unknown graph type " << p.graph << endl;
+        exit(0);
+    }
+
+    Wcsp wcsp;
+    vector<vector<int>> clusters;
+    WcspGenerator gen(p);
+    gen.generate(wcsp, clusters);
+    wcsp.write(out);
+    WcspGenerator::writePartitions(out + ".td.l2r", clusters);
+
+    cout << out << ": " << wcsp.nvars << " variables " << wcsp.nfuncs << " functions "
+         << clusters.size() << " clusters ub " << wcsp.ub << endl;
+    if (p.planted) cout << "planted optimum: " << gen.plantedCost() << endl;
+}
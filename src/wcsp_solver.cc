@@ -1,13 +1,23 @@
+#include <algorithm>
+#include <cstdio>
+#include <unistd.h>
 #include "wcsp_solver.hh"
 #include "csp_sat.hh"
+#include "config.hh"
+#include "budget.hh"
+#include "metrics.hh"
 
+const int MERGE_CORE_SIZE = 16;     // co-occurrence is counted on cores hit by at most this many partitions
+const int MERGE_MAX_LEVELS = 1000;  // cost levels of a merged partition
+const uint32_t CKPT_MAGIC = 0x4d48534b;  // "MHSK"
+const uint32_t CKPT_VERSION = 2;
 
 WcspSolver::WcspSolver(const Wcsp &wcsp, const vector<vector<int>>& part)
-    : wcsp(wcsp), mhvs(nullptr) {
+    : wcsp(wcsp), mhvs(nullptr), ls(nullptr) {
     ces = new CSP_sat(wcsp, part);
 }
 
-WcspSolver::WcspSolver(const Wcsp &wcsp): wcsp(wcsp), mhvs(nullptr) {
+WcspSolver::WcspSolver(const Wcsp &wcsp): wcsp(wcsp), mhvs(nullptr), ls(nullptr) {
     ces = new CSP_sat(wcsp);
 }
 
@@ -15,6 +25,10 @@ void WcspSolver::case_study_abstract_core() {
     ces->case_study_abstract_core();
 }
 
+void WcspSolver::abstract_core(const vector<vector<int>>& clusters) {
+    ces->abstract_core(clusters);
+}
+
 void WcspSolver::update_non_dominated(const vector<int>& k) {
     int i = 0;
     while (i < nd_cores.size()) {
@@ -26,36 +40,383 @@ void WcspSolver::update_non_dominated(const vector<int>& k) {
     nd_cores.push_back(k);
 }
 
+// Post: cost levels that cannot be part of a solution cheaper than ub are
+//       forbidden in the CSP and in the MHV models. The cost of the other
+//       partitions is bounded by a set of cores hit by disjoint partitions.
+//       Returns the number of partitions hardened.
+int WcspSolver::harden(Cost ub) {
+  const vector<vector<Cost>>& part = ces->part;
+  // cost of hitting each core: <cost, core id>
+  vector<pair<Cost, int>> hit_cost;
+  for (int j = 0; j < nd_cores.size(); ++j) {
+    const vector<int>& k = nd_cores[j];
+    Cost w = ub;
+    for (int i = 0; i < k.size(); ++i)
+      if (k[i] < ces->last_idx(i)) w = min(w, part[i][k[i] + 1]);
+    hit_cost.push_back(make_pair(w, j));
+  }
+  sort(hit_cost.rbegin(), hit_cost.rend());
+
+  Cost lb_dis = 0;
+  vector<Cost> owner(part.size(), 0); // hit cost of the core selected that contains i
+  for (const pair<Cost, int>& p : hit_cost) {
+    const vector<int>& k = nd_cores[p.second];
+    bool disjoint = true;
+    for (int i = 0; i < k.size() and disjoint; ++i)
+      if (k[i] < ces->last_idx(i) and owner[i] > 0) disjoint = false;
+    if (not disjoint) continue;
+    lb_dis += p.first;
+    for (int i = 0; i < k.size(); ++i)
+      if (k[i] < ces->last_idx(i)) owner[i] = p.first;
+  }
+
+  int hardened = 0;
+  for (int f = 0; f < part.size(); ++f) {
+    Cost others = lb_dis - owner[f];
+    for (int c = 1; c <= ces->last_idx(f); ++c) {
+      if (part[f][c] + others > ub) {
+        ces->harden(f, c);
+        mhvs->fixLevel(f, c);
+        ++hardened;
+        break;
+      }
+    }
+  }
+  return hardened;
+}
+
+// Post: levels fixed to 0 by the reduced costs of the mhv lp relaxation
+//       are forbidden in the CSP model too. Returns the number of fixings
+int WcspSolver::reduced_cost_fixing(Cost ub) {
+  vector<pair<int,int>> fixed;
+  int n = mhvs->reducedCostFixing(ub, fixed);
+  for (const pair<int,int>& p : fixed) ces->harden(p.first, p.second);
+  return n;
+}
+
+// size (partitions that can hit it) and weight (min cost to hit it) of core k
+void WcspSolver::core_metrics(const vector<int>& k) {
+  int size = 0;
+  Cost weight = wcsp.ub;
+  for (int i = 0; i < k.size(); ++i) if (k[i] < ces->last_idx(i)) {
+    ++size;
+    weight = min(weight, ces->part[i][k[i] + 1]);
+  }
+  Metrics::coreSize.add(size);
+  Metrics::coreWeight.add(weight);
+}
+
+void WcspSolver::count_cooccurrence(const vector<int>& k) {
+  vector<int> hit;
+  for (int i = 0; i < k.size(); ++i) if (k[i] < ces->last_idx(i)) hit.push_back(i);
+  if (hit.size() > MERGE_CORE_SIZE) return;
+  for (int a = 0; a < hit.size(); ++a)
+    for (int b = a + 1; b < hit.size(); ++b) ++cooc[make_pair(hit[a], hit[b])];
+}
+
+// Post: the pairs of partitions that share at least mergeThreshold cores are
+//       merged (most shared first) and nd_cores is remapped to the merged
+//       partitions. Returns the number of merges
+int WcspSolver::merge_partitions() {
+  int merged = 0;
+  while (true) {
+    map<pair<int,int>, int>::iterator best = cooc.end();
+    for (auto it = cooc.begin(); it != cooc.end(); ++it)
+      if (it->second >= HsConfig::mergeThreshold and (best == cooc.end() or it->second > best->second))
+        best = it;
+    if (best == cooc.end()) break;
+
+    int i = best->first.first, j = best->first.second;
+    vector<Cost> cost_i = ces->part[i], cost_j = ces->part[j];
+    int last_i = ces->last_idx(i), last_j = ces->last_idx(j);
+    if (not ces->merge(i, j, MERGE_MAX_LEVELS)) {  // too many levels (counted again from 0)
+      cooc.erase(best);
+      continue;
+    }
+    ++merged;
+    const vector<Cost>& cost_m = ces->part[i];
+    cout << "   merged partitions " << i << " " << j << " (" << best->second << " cores): "
+         << cost_m.size() << " levels" << endl;
+
+    // a core k stays a core with the merged level of the largest sum within
+    // both k[i] and k[j] (a level that cannot be hit is not a bound)
+    vector<vector<int>> cores;
+    cores.swap(nd_cores);
+    for (vector<int>& k : cores) {
+      Cost bound = wcsp.ub;
+      if (k[i] < last_i) bound = min(bound, cost_i[k[i]]);
+      if (k[j] < last_j) bound = min(bound, cost_j[k[j]]);
+      k[i] = cost_m.size() - 1;
+      if (bound < wcsp.ub) k[i] = upper_bound(cost_m.begin(), cost_m.end(), bound) - cost_m.begin() - 1;
+      k.erase(k.begin() + j);
+    }
+    for (const vector<int>& k : cores) {
+      bool dominated = false;
+      for (const vector<int>& k2 : nd_cores) if (k <= k2) dominated = true;
+      if (not dominated) update_non_dominated(k);
+    }
+
+    map<pair<int,int>, int> remapped;
+    for (const auto& p : cooc) {
+      int a = p.first.first == j ? i : (p.first.first > j ? p.first.first - 1 : p.first.first);
+      int b = p.first.second == j ? i : (p.first.second > j ? p.first.second - 1 : p.first.second);
+      if (a == b) continue;
+      remapped[make_pair(min(a, b), max(a, b))] += p.second;
+    }
+    cooc.swap(remapped);
+  }
+  return merged;
+}
+
+// Post: mhvs is a new MHV model over the current partitions with the
+//       non-dominated cores and the hardened levels
+void WcspSolver::rebuild_mhv() {
+  delete mhvs;
+  mhvs = new MHV_cplex(ces->part);
+  for (int f = 0; f < ces->part.size(); ++f)
+    if (ces->last_idx(f) < ces->part[f].size() - 1) mhvs->fixLevel(f, ces->last_idx(f) + 1);
+  for (const vector<int>& k : nd_cores) mhvs->addCore(k);
+}
+
+// Post: checkpointFile holds the partition layout, the bounds, the
+//       incumbent and the non-dominated cores (written through a temporary
+//       file, so a preemption never leaves a partial checkpoint)
+void WcspSolver::save_checkpoint(Cost lb, Cost ub, int iteration, int ncores) const {
+  const string& file = HsConfig::checkpointFile;
+  string tmp = file + ".tmp" + std::to_string(getpid());
+  {
+    std::ofstream out(tmp, std::ios::binary);
+    if (not out.is_open()) {
+      cerr << "Warning: checkpoint " << file << " cannot be written" << endl;
+      return;
+    }
+    Cost header[] = {wcsp.nvars, wcsp.lb, wcsp.ub, lb, ub, iteration, ncores};
+    out.write((const char*) &CKPT_MAGIC, sizeof(CKPT_MAGIC));
+    out.write((const char*) &CKPT_VERSION, sizeof(CKPT_VERSION));
+    out.write((const char*) &ces->hash, sizeof(ces->hash));
+    out.write((const char*) header, sizeof(header));
+    uint64_t nparts = ces->part.size();
+    out.write((const char*) &nparts, sizeof(nparts));
+    for (const vector<Cost>& p : ces->part) write_vector(out, p);
+    write_vector(out, best_sol);
+    // cores: one level index per partition, as 16 bits if possible
+    bool narrow = true;
+    for (const vector<Cost>& p : ces->part) narrow = narrow and p.size() <= 65536;
+    uint64_t n = nd_cores.size();
+    out.write((const char*) &n, sizeof(n));
+    out.write((const char*) &narrow, sizeof(narrow));
+    for (const vector<int>& k : nd_cores) {
+      if (narrow) write_vector(out, vector<uint16_t>(k.begin(), k.end()));
+      else write_vector(out, k);
+    }
+  }
+  std::rename(tmp.c_str(), file.c_str());
+}
+
+// Post: if checkpointFile exists and was written over the same instance and
+//       partitions (same hash and cost levels), nd_cores, best_sol and the
+//       bounds are restored; true in that case. Data that does not fit the
+//       instance (sizes, levels, lb > ub) makes it ignored
+bool WcspSolver::load_checkpoint(Cost& lb, Cost& ub, int& iteration, int& ncores) {
+  const string& file = HsConfig::checkpointFile;
+  std::ifstream in(file, std::ios::binary);
+  if (not in.is_open()) return false;
+  uint32_t magic = 0, version = 0;
+  uint64_t hash = 0;
+  Cost header[7];
+  in.read((char*) &magic, sizeof(magic));
+  in.read((char*) &version, sizeof(version));
+  in.read((char*) &hash, sizeof(hash));
+  in.read((char*) header, sizeof(header));
+  uint64_t nparts = 0;
+  if (not in or magic != CKPT_MAGIC or version != CKPT_VERSION or not in.read((char*) &nparts, sizeof(nparts))) {
+    cerr << "Error: invalid checkpoint " << file << endl;
+    exit(EXIT_FAILURE);
+  }
+  bool same = hash == ces->hash and header[0] == wcsp.nvars and header[1] == wcsp.lb
+              and header[2] == wcsp.ub and nparts == ces->part.size();
+  for (int i = 0; same and i < nparts; ++i) {
+    vector<Cost> p;
+    same = read_vector(in, p) and p.size() == ces->part[i].size() and std::equal(p.begin(), p.end(), ces->part[i].begin());
+  }
+  if (not same) {  // e.g. partitions merged during the run
+    cout << "Checkpoint " << file << " ignored: other instance or partitions" << endl;
+    return false;
+  }
+  vector<int> sol;
+  read_vector(in, sol);
+  uint64_t n = 0;
+  bool narrow = true;
+  in.read((char*) &n, sizeof(n));
+  in.read((char*) &narrow, sizeof(narrow));
+  vector<vector<int>> cores;
+  for (uint64_t c = 0; c < n and in; ++c) {
+    vector<int> k;
+    if (narrow) {
+      vector<uint16_t> k16;
+      read_vector(in, k16);
+      k.assign(k16.begin(), k16.end());
+    }
+    else read_vector(in, k);
+    cores.push_back(k);
+  }
+  if (not in) {
+    cerr << "Error: truncated checkpoint " << file << endl;
+    exit(EXIT_FAILURE);
+  }
+  bool fits = header[3] <= header[4] and (sol.empty() or sol.size() == wcsp.nvars);
+  for (int x = 0; fits and x < sol.size(); ++x) fits = 0 <= sol[x] and sol[x] < wcsp.domsize[x];
+  for (const vector<int>& k : cores) {
+    fits = fits and k.size() == nparts;
+    for (int f = 0; fits and f < k.size(); ++f) fits = 0 <= k[f] and k[f] < ces->part[f].size();
+  }
+  if (not fits) {
+    cout << "Checkpoint " << file << " ignored: bounds, solution or cores do not fit the instance" << endl;
+    return false;
+  }
+
+  lb = header[3];
+  ub = header[4];
+  iteration = header[5];
+  ncores = header[6];
+  if (not sol.empty() and wcsp.costAssign(sol) == ub) best_sol = sol;
+  else ub = wcsp.ub;
+  nd_cores = cores;
+  for (const vector<int>& k : nd_cores) mhvs->addCore(k);
+  cout << "Resumed from " << file << ": iteration " << iteration << "  lb " << wcsp.lb + lb
+       << "  ub " << wcsp.lb + ub << "  non_dom_cores " << nd_cores.size() << endl;
+  return true;
+}
+
 Cost WcspSolver::solve() {
   int iteration = 0;
-  long t_solver = 0;
-  long t_mhv = 0;
   int ncores = 0;
   Cost lb = 0;
   Cost ub = wcsp.ub;
 
   mhvs = new MHV_cplex(ces->part);
+  if (not HsConfig::checkpointFile.empty() and load_checkpoint(lb, ub, iteration, ncores))
+    if (ub < wcsp.ub) harden(ub);  // the known ub forbids levels in the sat model
+  return optimize(lb, ub, iteration, ncores);
+}
+
+// Post: optimum of the instance after wcsp.apply(deltas) (Pre: applied, the
+//       solver built in incremental mode and solved). Only the partitions of
+//       the edited functions are encoded again and the cores that still hold
+//       are kept: those of partitions whose costs only increased, with the
+//       levels remapped as in merge_partitions()
+Cost WcspSolver::resolve(const vector<CostDelta>& deltas) {
+  assert(mhvs and HsConfig::incremental);
+  vector<int> funcs;
+  vector<bool> decreased(wcsp.nfuncs, false);
+  for (const CostDelta& d : deltas) {
+    if (find(funcs.begin(), funcs.end(), d.func) == funcs.end()) funcs.push_back(d.func);
+    if (d.delta < 0) decreased[d.func] = true;
+  }
+  vector<vector<Cost>> old_part = ces->part;
+  vector<bool> old_capped = ces->part_capped;
+  vector<int> parts = ces->update(funcs);
+
+  vector<vector<int>> cores;
+  cores.swap(nd_cores);
+  int kept = 0;
+  for (vector<int>& k : cores) {
+    bool holds = true;
+    for (int p : parts) {
+      const vector<Cost>& cost_p = ces->part[p];
+      bool in = k[p] < old_part[p].size() - 1;  // the core can be hit in p
+      bool dec = false;
+      for (int f : ces->members[p]) dec = dec or decreased[f];
+      // lower costs may satisfy it, or make sums < ub that were forbidden
+      if (dec and (in or old_capped[p])) holds = false;
+      else if (in) k[p] = upper_bound(cost_p.begin(), cost_p.end(), old_part[p][k[p]]) - cost_p.begin() - 1;
+      else k[p] = cost_p.size() - 1;
+    }
+    if (not holds) continue;
+    bool dominated = false;
+    for (const vector<int>& k2 : nd_cores) if (k <= k2) dominated = true;
+    if (not dominated) update_non_dominated(k);
+    ++kept;
+  }
+  cout << "Cost update: " << deltas.size() << " tuples, " << parts.size() << " partitions encoded again, "
+       << kept << " of " << cores.size() << " cores kept" << endl;
+
+  Cost ub = wcsp.ub;
+  if (not best_sol.empty()) {
+    Cost c = wcsp.costAssign(best_sol);
+    if (c < wcsp.ub) ub = c;
+    else best_sol.clear();
+  }
+  rebuild_mhv();
+  return optimize(0, ub, 0, 0);
+}
+
+// Post: lb and ub raised until they meet or the budget is exhausted, from
+//       the cores already in mhvs and the incumbent best_sol of cost ub
+Cost WcspSolver::optimize(Cost lb, Cost ub, int iteration, int ncores) {
+  long t_solver = 0;
+  long t_mhv = 0;
+  int nhard = 0;
+
   vector<int> h(ces->part.size(), 0);
-  assert(h.size() == ces->part.size());
+  if (not nd_cores.empty() and mhvs->solve_MHV(t_mhv)) {  // hits the known cores
+    h = mhvs->getMHV_idom();
+    lb = ces->vector_cost(h);
+  }
+  if (HsConfig::localSearch) {
+    delete ls;
+    ls = new LocalSearch(wcsp);
+    ls->start();
+    if (not best_sol.empty()) ls->seed(best_sol);
+  }
+  if (HsConfig::solutionPhases and not best_sol.empty()) ces->set_phases(best_sol);
+  bool checkpoint = not HsConfig::checkpointFile.empty();
+  auto last_checkpoint = steady_clock::now();
+
+  optimal = false;
+  while (true) {
+    if (ces->solve(h, t_solver)) {  // wcsp^h sat: lb is the optimum
+      optimal = true;
+      best_sol = ces->getSolution();
+      break;
+    }
+    if (ces->interrupted) break;
+    if (ls) ls->seed(ces->getSolution());
 
-  while (not ces->solve(h, t_solver)) {
     // add cores to the mhv solver
     const vector<vector<int>> &C = ces->getCores();
     for (const vector<int> &k : C) {
       mhvs->addCore(k);
       update_non_dominated(k);
+      if (Metrics::enabled) core_metrics(k);
+      if (HsConfig::mergeThreshold > 0) count_cooccurrence(k);
     }
     ncores += C.size();
+    if (HsConfig::mergeThreshold > 0 and merge_partitions() > 0) rebuild_mhv();
 
     // compute new hitting vector
+    long t_mhv_prev = t_mhv;
     bool hv_found = mhvs->solve_MHV(t_mhv);
-    assert(hv_found);
+    if (Metrics::enabled) Metrics::mhvCall.add(t_mhv - t_mhv_prev);
+    if (not hv_found) break;  // budget exhausted
     h = mhvs->getMHV_idom();
 
     // update bounds
     lb = ces->vector_cost(h);
     assert(lb == mhvs->getCost_MHV());
-    ub = min(ub, wcsp.costAssign(ces->getSolution()));
+    Cost sol_cost = wcsp.costAssign(ces->getSolution());
+    if (sol_cost < ub) {
+      ub = sol_cost;
+      best_sol = ces->getSolution();
+    }
+    if (ls and ls->getUB() < ub) {
+      ub = ls->getUB();
+      best_sol = ls->getSolution();
+      if (HsConfig::solutionPhases) ces->set_phases(best_sol); // the last solution is worse
+    }
+
+    if (HsConfig::hardening and lb < ub) nhard += harden(ub);
+    if (HsConfig::rcFixing and lb < ub and ub < wcsp.ub) nhard += reduced_cost_fixing(ub);
 
     iteration++;
     cout << "Iteration " << iteration
@@ -64,7 +425,29 @@ Cost WcspSolver::solve() {
          << "  cores " << ncores << " non_dom_cores " << nd_cores.size()
          << "  time " << t_solver / 1000000.0 << " " << t_mhv / 1000000.0
          << "  satcalls " << ces->sat_calls << endl;
+    Metrics::iteration(iteration, wcsp.lb + lb, wcsp.lb + ub, ncores, nd_cores.size(),
+                       t_solver, t_mhv, ces->sat_calls);
 
+    if (lb == ub) {  // the incumbent is optimal
+      optimal = true;
+      break;
+    }
+    if (Budget::expired()) break;
+    if (checkpoint and duration<double>(steady_clock::now() - last_checkpoint).count() >= HsConfig::checkpointInterval) {
+      save_checkpoint(lb, ub, iteration, ncores);
+      last_checkpoint = steady_clock::now();
+    }
+  }
+  if (ls) ls->stop();
+  if (checkpoint and not optimal) save_checkpoint(lb, ub, iteration, ncores);
+  if (not best_sol.empty()) best_sol = wcsp.reconstruct(best_sol);
+  if (HsConfig::hardening or HsConfig::rcFixing)
+    cout << "   hardened partitions: " << nhard << endl;
+  if (not optimal) {
+    cout << "   interrupted: lb " << wcsp.lb + lb << " ub ";
+    if (best_sol.empty()) cout << "none" << endl;
+    else cout << wcsp.lb + ub << endl << "   best solution: " << best_sol << endl;
+    return wcsp.lb + lb;
   }
   cout << "   optimum (subprob): " << lb << endl;
   return wcsp.lb + lb;
@@ -1,12 +1,15 @@
 #ifndef WCSP_SOLVER_HH
 #define WCSP_SOLVER_HH
 
+#include <map>
 #include <vector>
 
 #include "MHV_cpx.hh"
 #include "csp.hh"
+#include "local_search.hh"
 #include "wcsp.hh"
 
+using std::map;
 using std::vector;
 
 class WcspSolver {
@@ -15,20 +18,37 @@ public:
   WcspSolver(const Wcsp &wcsp, const vector<vector<int>>& part);
   WcspSolver(const Wcsp &wcsp, bool generator_type);
 
-  ~WcspSolver() {delete mhvs; delete ces;}
+  ~WcspSolver() {delete mhvs; delete ces; delete ls;}
   Cost solve();
+  Cost resolve(const vector<CostDelta>& deltas);
+  bool isOptimal() const { return optimal; }     // PRE: solve() called
+  const vector<int>& getSolution() const { return best_sol; }
   void case_study_abstract_core();
+  void abstract_core(const vector<vector<int>>& clusters);
 
 private:
     const Wcsp& wcsp;               // WCSP data
     MHV_cplex* mhvs;                // MHV solver for the set of cores
     vector<vector<int>> nd_cores;   // non-dominated set of cores
     CoreCSP* ces;                   // CSP solver
+    LocalSearch* ls;                // local search for upper bounds (nullptr if disabled)
+    vector<int> best_sol;           // best assignment found (cost ub)
+    bool optimal;                   // solve() proved optimality (not interrupted)
+    map<pair<int,int>, int> cooc;   // cores shared by each pair of partitions (i < j)
 
     void add_core(vector<vector<int>> &K2, const vector<int> &k);
     Cost solve_lb(vector<int>& h, const vector<bool>& active,
                   int& iteration, int& ncores, long& t_solver, long& t_mhv);
     void update_non_dominated(const vector<int>& k);
+    int harden(Cost ub);
+    void core_metrics(const vector<int>& k);
+    int reduced_cost_fixing(Cost ub);
+    void count_cooccurrence(const vector<int>& k);
+    int merge_partitions();
+    void rebuild_mhv();
+    Cost optimize(Cost lb, Cost ub, int iteration, int ncores);
+    void save_checkpoint(Cost lb, Cost ub, int iteration, int ncores) const;
+    bool load_checkpoint(Cost& lb, Cost& ub, int& iteration, int& ncores);
 };
 
 #endif